@@ -9,12 +9,72 @@
 #include <iomanip>
 #include <queue>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <csignal>
+#include <tuple>
+#include <cstdio>
+#include <new>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
 
 using namespace std;
 
+// Heap allocations made by each thread, counted for the allocation benchmark (--bench-alloc).
+// Counting puts a thread-local increment on every allocation in the program, so it is only
+// compiled into benchmark builds (-DRAILWAY_COUNT_ALLOCATIONS); otherwise --bench-alloc
+// reports timings alone.
+#ifdef RAILWAY_COUNT_ALLOCATIONS
+const bool countingAllocations = true;
+thread_local unsigned long long threadAllocations = 0;
+
+void* operator new(size_t size) {
+    threadAllocations++;
+    void* block = malloc(size == 0 ? 1 : size);
+    if (block == NULL) throw bad_alloc();
+    return block;
+}
+
+// Kept out of line so the compiler never sees a new-expression released by a bare free()
+__attribute__((noinline)) void operator delete(void* block) noexcept {
+    free(block);
+}
+
+__attribute__((noinline)) void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
+#else
+const bool countingAllocations = false;
+const unsigned long long threadAllocations = 0;
+#endif
+
 struct Station {
     string name;
     vector<pair<int, int> > connections; // pair<station_index, distance>
+    double latitude;                     // degrees, only meaningful if hasCoordinates
+    double longitude;
+    bool hasCoordinates;
+
+    Station() : latitude(0), longitude(0), hasCoordinates(false) {}
 };
 
 enum TicketClass {
@@ -24,601 +84,7031 @@ enum TicketClass {
     FIRST_CLASS = 4
 };
 
-struct FareInfo {
-    int generalFare;
-    int sleeperFare;
-    int acFare;
-    int firstClassFare;
-    
-    FareInfo(int distance) {
-        generalFare = distance * 2;      // 2 per km
-        sleeperFare = distance * 3;      // 3 per km
-        acFare = distance * 5;           // 5 per km
-        firstClassFare = distance * 8;   // 8 per km
-    }
-};
+const double AVERAGE_SPEED_KMPH = 60.0;
 
 struct TimeInfo {
     double hours;
     double minutes;
     
     TimeInfo(int distance) {
-        double averageSpeed = 60.0; // km/hr
-        hours = distance / averageSpeed;
+        hours = distance / AVERAGE_SPEED_KMPH;
         minutes = (hours - (int)hours) * 60;
     }
+
+    int totalMinutes() const { return (int)hours * 60 + (int)minutes; }
+};
+
+// Usernames and other write-once strings live back to back in one arena and are
+// referred to by offset, instead of one heap-allocated std::string each
+struct StringPool {
+    vector<char> bytes; // NUL-terminated strings
+
+    uint32_t add(const string& text) {
+        uint32_t offset = bytes.size();
+        bytes.insert(bytes.end(), text.begin(), text.end());
+        bytes.push_back('\0');
+        return offset;
+    }
+
+    const char* get(uint32_t offset) const { return &bytes[offset]; }
+
+    // Whether offset can be passed to get: inside the arena, which ends with a terminator
+    bool holds(uint32_t offset) const { return offset < bytes.size() && bytes.back() == '\0'; }
 };
 
 struct User {
-    string username;
+    uint32_t nameOffset; // username in userNames
     string password;
-    vector<int> bookingIds;
 };
 
-struct Booking {
-    int ticketNumber;
-    string passengerName;
-    int age;
-    int fromStation;
-    int toStation;
-    TicketClass ticketClass;
-    int distance;
-    int fare;
-    double travelTime;
-    string username;
-    bool isActive;
-    
-    Booking(int ticketNum, string name, int passengerAge, int from, int to, 
-            TicketClass tClass, int dist, int fareAmount, double time, string user) {
-        ticketNumber = ticketNum;
-        passengerName = name;
-        age = passengerAge;
-        fromStation = from;
-        toStation = to;
-        ticketClass = tClass;
-        distance = dist;
-        fare = fareAmount;
-        travelTime = time;
-        username = user;
-        isActive = true;
+const int MAX_BOOKABLE_STATIONS = 65536; // station columns are 16-bit
+const int MAX_PASSENGER_AGE = 125;       // age column is 8-bit
+const int MAX_TRAIN_NUMBER = 99999;      // five-digit train numbers
+const int MAX_TRAVEL_DAY = 65535;        // travel day column is 16-bit (through 2149)
+
+// Bookings stored column by column: one array per field, indexed by booking slot.
+// Stations and travel day fit in 16 bits and class/age in 8; passenger names go into
+// an arena and travel time is derived from distance, so a row costs 36 bytes plus the
+// name and the stations of its route.
+// Scans over a couple of columns (see countActiveBookings) touch only those arrays.
+struct BookingLedger {
+    vector<int> ticketNumber;
+    vector<uint16_t> fromStation;
+    vector<uint16_t> toStation;
+    vector<uint8_t> ticketClass;
+    vector<uint8_t> age;
+    vector<uint32_t> distance;
+    vector<uint32_t> fare;
+    vector<int> userId;
+    vector<uint32_t> passengerName; // offset into passengerNames
+    vector<uint32_t> train;
+    vector<uint16_t> travelDay;     // days since 1970-01-01
+    vector<uint32_t> routeStart;    // first entry in routeStations; the next slot's start ends the range
+    vector<uint16_t> routeStations; // booked route, from first to last station
+    vector<uint64_t> activeBits;    // bit set while the booking is active
+    StringPool passengerNames;
+
+    int size() const { return ticketNumber.size(); }
+
+    bool isActive(int slot) const { return (activeBits[slot >> 6] >> (slot & 63)) & 1; }
+
+    void setActive(int slot, bool active) {
+        if (active) activeBits[slot >> 6] |= 1ULL << (slot & 63);
+        else activeBits[slot >> 6] &= ~(1ULL << (slot & 63));
+    }
+
+    // Append an active booking and return its slot
+    int append(int ticket, const string& name, int passengerAge, int from, int to,
+               TicketClass tClass, int dist, int fareAmount, int user,
+               int trainNumber, int day, const vector<int>& route) {
+        int slot = size();
+        ticketNumber.push_back(ticket);
+        fromStation.push_back(from);
+        toStation.push_back(to);
+        ticketClass.push_back(tClass);
+        age.push_back(passengerAge);
+        distance.push_back(dist);
+        fare.push_back(fareAmount);
+        userId.push_back(user);
+        passengerName.push_back(passengerNames.add(name));
+        train.push_back(trainNumber);
+        travelDay.push_back(day);
+        routeStart.push_back(routeStations.size());
+        routeStations.insert(routeStations.end(), route.begin(), route.end());
+        if ((slot & 63) == 0) activeBits.push_back(0);
+        setActive(slot, true);
+        return slot;
+    }
+
+    // Append a copy of another ledger's row, active or not; returns the new slot
+    int appendRow(const BookingLedger& source, int from) {
+        int slot = size();
+        ticketNumber.push_back(source.ticketNumber[from]);
+        fromStation.push_back(source.fromStation[from]);
+        toStation.push_back(source.toStation[from]);
+        ticketClass.push_back(source.ticketClass[from]);
+        age.push_back(source.age[from]);
+        distance.push_back(source.distance[from]);
+        fare.push_back(source.fare[from]);
+        userId.push_back(source.userId[from]);
+        passengerName.push_back(passengerNames.add(source.getPassengerName(from)));
+        train.push_back(source.train[from]);
+        travelDay.push_back(source.travelDay[from]);
+        routeStart.push_back(routeStations.size());
+        routeStations.insert(routeStations.end(), source.routeStations.begin() + source.routeStart[from],
+                             source.routeStations.begin() + source.routeEnd(from));
+        if ((slot & 63) == 0) activeBits.push_back(0);
+        setActive(slot, source.isActive(from));
+        return slot;
+    }
+
+    const char* getPassengerName(int slot) const { return passengerNames.get(passengerName[slot]); }
+
+    int routeEnd(int slot) const { return slot + 1 < size() ? routeStart[slot + 1] : routeStations.size(); }
+
+    // Active bookings of one class leaving one station; branch-free so the loop vectorizes
+    int countActiveBookings(int station, TicketClass tClass) const {
+        int count = 0, n = size();
+        const uint16_t* from = fromStation.data();
+        const uint8_t* classes = ticketClass.data();
+        const uint64_t* bits = activeBits.data();
+        for (int i = 0; i < n; i++) {
+            count += (from[i] == station) & (classes[i] == tClass) & (int)(bits[i >> 6] >> (i & 63));
+        }
+        return count;
     }
 };
 
+// Compressed-sparse-row (CSR) form of the network used by all route searches.
+// The arcs of station u are neighbors[offsets[u]] .. neighbors[offsets[u + 1] - 1],
+// with the matching distances at the same positions in weights.
+struct StationGraph {
+    int stationCount;
+    vector<int> offsets;   // stationCount + 1 entries
+    vector<int> neighbors; // arc targets, grouped by source station
+    vector<int> weights;   // arc distances in km, parallel to neighbors
+    long long version;     // graphVersion this graph was frozen from
+
+    // Geographic lower bound for A*: scale * greatCircleKm(u, v) never exceeds the
+    // track distance between u and v. scale is 0 when any station lacks coordinates.
+    vector<double> latitudeRad;
+    vector<double> longitudeRad;
+    double heuristicScale;
+
+    StationGraph() : stationCount(0), version(-1), heuristicScale(0) {}
+};
+
+enum RouteEngine {
+    ENGINE_DIJKSTRA = 1,
+    ENGINE_BIDIRECTIONAL_ASTAR = 2,
+    ENGINE_CONTRACTION_HIERARCHY = 3
+};
+
 vector<Station> stations;
 vector<User> users;
-vector<Booking> bookings;
-string currentUser = "";
-int nextTicketNumber = 1001;
+
+// Bookings are split over shards by user, each with its own lock and ledger, so bookings,
+// cancellations and listings for users in different shards never wait for each other.
+// Ticket numbers come from one atomic counter, so they are unique across shards.
+struct BookingShard {
+    mutex lock;
+    BookingLedger ledger;
+    unordered_map<int, int> slotByTicket;
+    vector<vector<int> > slotsByUser; // each user's slots in booking order, indexed by userId / BOOKING_SHARD_COUNT
+};
+
+const int BOOKING_SHARD_COUNT = 64;
+BookingShard bookingShards[BOOKING_SHARD_COUNT];
+
+// One client of the system: the console menu, or one connection to the request server
+struct Session {
+    int userId; // index into users, -1 when nobody is logged in
+
+    Session() : userId(-1) {}
+
+    bool loggedIn() const { return userId != -1; }
+};
+
+const int FIRST_TICKET_NUMBER = 1001;
+atomic<int> nextTicketNumber(FIRST_TICKET_NUMBER);
+
+// Bumped on every change to stations or connections; the frozen graph is rebuilt when stale
+atomic<long long> graphVersion(0);
+StationGraph stationGraph;
+
+// Engine used for point-to-point queries; verifyRouteEngine cross-checks it against plain Dijkstra
+RouteEngine routeEngine = ENGINE_BIDIRECTIONAL_ASTAR;
+bool verifyRouteEngine = false;
 
 void addStation(const string& name) {
     Station newStation;
     newStation.name = name;
     stations.push_back(newStation);
-    cout << "Station added: " << name << endl;
+    graphVersion++;
+}
+
+void addStation(const string& name, double latitude, double longitude) {
+    addStation(name);
+    stations.back().latitude = latitude;
+    stations.back().longitude = longitude;
+    stations.back().hasCoordinates = true;
+}
+
+// Haversine distance in km between two points given in radians
+double greatCircleKm(double lat1, double lon1, double lat2, double lon2) {
+    const double EARTH_RADIUS_KM = 6371.0;
+    double sinLat = sin((lat2 - lat1) / 2);
+    double sinLon = sin((lon2 - lon1) / 2);
+    double a = sinLat * sinLat + cos(lat1) * cos(lat2) * sinLon * sinLon;
+    return 2 * EARTH_RADIUS_KM * asin(min(1.0, sqrt(a)));
+}
+
+// Track segments are station pairs numbered in the order they are first connected.
+// Seat inventory is counted per segment, so the numbers never change once assigned.
+unordered_map<uint64_t, int> segmentIds;
+
+uint64_t segmentKey(int a, int b) {
+    return ((uint64_t)min(a, b) << 32) | (uint32_t)max(a, b);
+}
+
+void registerSegment(int a, int b) {
+    uint64_t key = segmentKey(a, b);
+    if (segmentIds.find(key) == segmentIds.end()) {
+        int id = segmentIds.size();
+        segmentIds[key] = id;
+    }
+}
+
+// Segment between two adjacent stations, or -1 if they are not connected
+int getSegmentId(int a, int b) {
+    unordered_map<uint64_t, int>::const_iterator it = segmentIds.find(segmentKey(a, b));
+    return it == segmentIds.end() ? -1 : it->second;
 }
 
 void addConnection(int from, int to, int distance) {
+    registerSegment(from, to);
     stations[from].connections.push_back(make_pair(to, distance));
     stations[to].connections.push_back(make_pair(from, distance));
+    graphVersion++;
 }
 
-void displayStations() {
-    cout << "\nAvailable Stations:\n";
+void computeHeuristicScale(const vector<Station>& source, StationGraph& graph);
+
+// Pack the build-time adjacency lists into contiguous CSR arrays
+void freezeGraph(const vector<Station>& source, StationGraph& graph) {
+    int n = source.size();
+    int arcCount = 0;
+    for (int i = 0; i < n; i++) {
+        arcCount += source[i].connections.size();
+    }
+
+    graph.stationCount = n;
+    graph.offsets.assign(n + 1, 0);
+    graph.neighbors.resize(arcCount);
+    graph.weights.resize(arcCount);
+    graph.neighbors.shrink_to_fit();
+    graph.weights.shrink_to_fit();
+
+    int pos = 0;
+    for (int u = 0; u < n; u++) {
+        graph.offsets[u] = pos;
+        for (int j = 0; j < source[u].connections.size(); j++) {
+            graph.neighbors[pos] = source[u].connections[j].first;
+            graph.weights[pos] = source[u].connections[j].second;
+            pos++;
+        }
+    }
+    graph.offsets[n] = pos;
+    computeHeuristicScale(source, graph);
+}
+
+// Scale the great-circle bound down to the tightest track/straight-line ratio so it stays
+// admissible; graph already holds the arcs of source
+void computeHeuristicScale(const vector<Station>& source, StationGraph& graph) {
+    int n = source.size();
+    graph.latitudeRad.clear();
+    graph.longitudeRad.clear();
+    graph.heuristicScale = 0;
+    for (int u = 0; u < n; u++) {
+        if (!source[u].hasCoordinates) return;
+    }
+    const double DEG_TO_RAD = M_PI / 180.0;
+    graph.latitudeRad.resize(n);
+    graph.longitudeRad.resize(n);
+    for (int u = 0; u < n; u++) {
+        graph.latitudeRad[u] = source[u].latitude * DEG_TO_RAD;
+        graph.longitudeRad[u] = source[u].longitude * DEG_TO_RAD;
+    }
+    double scale = 1.0;
+    for (int u = 0; u < n; u++) {
+        for (int j = graph.offsets[u]; j < graph.offsets[u + 1]; j++) {
+            int v = graph.neighbors[j];
+            double straight = greatCircleKm(graph.latitudeRad[u], graph.longitudeRad[u],
+                                            graph.latitudeRad[v], graph.longitudeRad[v]);
+            if (straight > 0 && graph.weights[j] < scale * straight) {
+                scale = graph.weights[j] / straight;
+            }
+        }
+    }
+    graph.heuristicScale = scale * 0.999999; // margin for floating-point rounding
+}
+
+// Freeze the global network once loading is finished (called from main)
+void freezeStationGraph() {
+    freezeGraph(stations, stationGraph);
+    stationGraph.version = graphVersion;
+}
+
+// Frozen graph for the global network, refrozen lazily after any addStation/addConnection
+const StationGraph& getStationGraph() {
+    if (stationGraph.version != graphVersion) {
+        freezeStationGraph();
+    }
+    return stationGraph;
+}
+
+// Network Files
+//
+// Source networks are CSV or TSV text, one record per line ('#' starts a comment):
+//   S,<name>[,<latitude>,<longitude>]     a station
+//   E,<from name>,<to name>,<km>          a two-way connection
+// A source file is compiled into a binary .rnet file that holds the frozen CSR
+// arrays and a string table, so loading it is a handful of bulk copies.
+
+const uint32_t NETWORK_MAGIC = 0x544E5752; // "RWNT"
+const uint32_t NETWORK_FORMAT_VERSION = 1;
+
+// Fixed-size header; the sections follow in this order, each naturally aligned:
+//   double latitude[stationCount], double longitude[stationCount],
+//   int32 offsets[stationCount + 1], int32 neighbors[arcCount], int32 weights[arcCount],
+//   uint32 nameOffsets[stationCount + 1], uint8 hasCoordinates[stationCount], char names[nameBytes]
+struct NetworkFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t stationCount;
+    uint32_t arcCount;
+    uint32_t nameBytes;
+    uint32_t reserved;
+    double heuristicScale; // informational; the loader recomputes it from the arcs
+};
+
+// Add connections in bulk, sizing every adjacency list once up front
+void addConnections(const vector<pair<int, int> >& endpoints, const vector<int>& distances) {
+    vector<int> extraDegree(stations.size(), 0);
+    for (int i = 0; i < endpoints.size(); i++) {
+        extraDegree[endpoints[i].first]++;
+        extraDegree[endpoints[i].second]++;
+    }
     for (int i = 0; i < stations.size(); i++) {
-        cout << i << ". " << stations[i].name << endl;
+        stations[i].connections.reserve(stations[i].connections.size() + extraDegree[i]);
     }
+    for (int i = 0; i < endpoints.size(); i++) {
+        registerSegment(endpoints[i].first, endpoints[i].second);
+        stations[endpoints[i].first].connections.push_back(make_pair(endpoints[i].second, distances[i]));
+        stations[endpoints[i].second].connections.push_back(make_pair(endpoints[i].first, distances[i]));
+    }
+    graphVersion++;
 }
 
-void displayFareOptions() {
-    cout << "\nTicket Classes:\n";
-    cout << "1. General (₹2 per km)\n";
-    cout << "2. Sleeper (₹3 per km)\n";
-    cout << "3. AC (₹5 per km)\n";
-    cout << "4. First Class (₹8 per km)\n";
+// Split one CSV/TSV line; the delimiter is a tab if the line has one, otherwise a comma
+void splitNetworkLine(const char* begin, const char* end, vector<string>& fields) {
+    fields.clear();
+    char delimiter = memchr(begin, '\t', end - begin) ? '\t' : ',';
+    const char* fieldStart = begin;
+    for (const char* p = begin; ; p++) {
+        if (p == end || *p == delimiter) {
+            const char* a = fieldStart;
+            const char* b = p;
+            while (a < b && (*a == ' ' || *a == '\r')) a++;
+            while (b > a && (b[-1] == ' ' || b[-1] == '\r')) b--;
+            fields.push_back(string(a, b));
+            if (p == end) break;
+            fieldStart = p + 1;
+        }
+    }
 }
 
-void calculateFare(int distance, TicketClass ticketClass) {
-    FareInfo fareInfo(distance);
-    TimeInfo timeInfo(distance);
-    
-    cout << "\n=== Route Information ===\n";
-    cout << "Distance: " << distance << " km\n";
-    cout << "Estimated Travel Time: " << (int)timeInfo.hours << " hours " 
-         << (int)timeInfo.minutes << " minutes\n";
-    
-    switch(ticketClass) {
-        case GENERAL:
-            cout << "Ticket Class: General\n";
-            cout << "Fare: ₹" << fareInfo.generalFare << endl;
-            break;
-        case SLEEPER:
-            cout << "Ticket Class: Sleeper\n";
-            cout << "Fare: ₹" << fareInfo.sleeperFare << endl;
-            break;
-        case AC:
-            cout << "Ticket Class: AC\n";
-            cout << "Fare: ₹" << fareInfo.acFare << endl;
-            break;
-        case FIRST_CLASS:
-            cout << "Ticket Class: First Class\n";
-            cout << "Fare: ₹" << fareInfo.firstClassFare << endl;
-            break;
+bool loadNetworkText(const string& path) {
+    ifstream in(path.c_str(), ios::binary);
+    if (!in) {
+        cerr << "Cannot open network file " << path << "\n";
+        return false;
     }
-    
-    cout << "\nAll Fare Options:\n";
-    cout << "General: ₹" << fareInfo.generalFare << endl;
-    cout << "Sleeper: ₹" << fareInfo.sleeperFare << endl;
-    cout << "AC: ₹" << fareInfo.acFare << endl;
-    cout << "First Class: ₹" << fareInfo.firstClassFare << endl;
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    // Rows are parsed into a new station list, which replaces the current network only once
+    // the whole file has been read without errors
+    vector<Station> parsed;
+    unordered_map<string, int> stationByName;
+    vector<pair<int, int> > endpoints;
+    vector<int> distances;
+    vector<string> fields;
+    int lineNumber = 0;
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == string::npos) lineEnd = text.size();
+        lineNumber++;
+        splitNetworkLine(text.data() + lineStart, text.data() + lineEnd, fields);
+        lineStart = lineEnd + 1;
+        if (fields[0].empty() || fields[0][0] == '#') continue;
+
+        if ((fields[0] == "S" || fields[0] == "s") && (fields.size() == 2 || fields.size() == 4)) {
+            if (fields[1].empty() || stationByName.count(fields[1])) {
+                cerr << path << ":" << lineNumber << ": missing or duplicate station name\n";
+                return false;
+            }
+            stationByName[fields[1]] = parsed.size();
+            parsed.push_back(Station());
+            parsed.back().name = fields[1];
+            if (fields.size() == 4) {
+                parsed.back().latitude = atof(fields[2].c_str());
+                parsed.back().longitude = atof(fields[3].c_str());
+                parsed.back().hasCoordinates = true;
+            }
+        } else if ((fields[0] == "E" || fields[0] == "e") && fields.size() == 4) {
+            unordered_map<string, int>::iterator from = stationByName.find(fields[1]);
+            unordered_map<string, int>::iterator to = stationByName.find(fields[2]);
+            int distance = atoi(fields[3].c_str());
+            if (from == stationByName.end() || to == stationByName.end() || distance <= 0) {
+                cerr << path << ":" << lineNumber << ": unknown station or invalid distance\n";
+                return false;
+            }
+            endpoints.push_back(make_pair(from->second, to->second));
+            distances.push_back(distance);
+        } else {
+            cerr << path << ":" << lineNumber << ": expected S,name[,lat,lon] or E,from,to,km\n";
+            return false;
+        }
+    }
+    stations.swap(parsed);
+    segmentIds.clear();
+    graphVersion++;
+    addConnections(endpoints, distances);
+    return true;
 }
 
-// User Management Functions
-bool registerUser() {
-    string username, password;
-    cout << "\n=== User Registration ===\n";
-    cout << "Enter username: ";
-    cin >> username;
-    
-    // Check if username already exists
-    for (int i = 0; i < users.size(); i++) {
-        if (users[i].username == username) {
-            cout << "Username already exists! Please choose a different username.\n";
+// Write the current network (frozen first if needed) as a binary .rnet file
+bool saveNetworkBinary(const string& path) {
+    const StationGraph& graph = getStationGraph();
+    int n = graph.stationCount;
+    StringPool names;
+    vector<uint32_t> nameOffsets;
+    vector<double> latitude(n), longitude(n);
+    vector<uint8_t> hasCoordinates(n);
+    for (int i = 0; i < n; i++) {
+        nameOffsets.push_back(names.bytes.size());
+        names.bytes.insert(names.bytes.end(), stations[i].name.begin(), stations[i].name.end());
+        latitude[i] = stations[i].latitude;
+        longitude[i] = stations[i].longitude;
+        hasCoordinates[i] = stations[i].hasCoordinates;
+    }
+    nameOffsets.push_back(names.bytes.size());
+
+    NetworkFileHeader header;
+    header.magic = NETWORK_MAGIC;
+    header.version = NETWORK_FORMAT_VERSION;
+    header.stationCount = n;
+    header.arcCount = graph.neighbors.size();
+    header.nameBytes = names.bytes.size();
+    header.reserved = 0;
+    header.heuristicScale = graph.heuristicScale;
+
+    ofstream out(path.c_str(), ios::binary | ios::trunc);
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)latitude.data(), n * sizeof(double));
+    out.write((const char*)longitude.data(), n * sizeof(double));
+    out.write((const char*)graph.offsets.data(), (n + 1) * sizeof(int));
+    out.write((const char*)graph.neighbors.data(), header.arcCount * sizeof(int));
+    out.write((const char*)graph.weights.data(), header.arcCount * sizeof(int));
+    out.write((const char*)nameOffsets.data(), nameOffsets.size() * sizeof(uint32_t));
+    out.write((const char*)hasCoordinates.data(), n);
+    out.write(names.bytes.data(), names.bytes.size());
+    return (bool)out.flush();
+}
+
+// Map a .rnet file, check it, then rebuild the station list from it and copy its CSR
+// arrays into the frozen graph, so no refreeze is needed. Nothing is replaced if the
+// file fails a check.
+bool loadNetworkBinary(const string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        cerr << "Cannot open network file " << path << "\n";
+        return false;
+    }
+    struct stat info;
+    void* mapped = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(NetworkFileHeader)) {
+        mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        cerr << "Cannot map network file " << path << "\n";
+        return false;
+    }
+
+    const char* base = (const char*)mapped;
+    const NetworkFileHeader* header = (const NetworkFileHeader*)base;
+    uint64_t n = header->stationCount, arcs = header->arcCount;
+    uint64_t expectedSize = sizeof(NetworkFileHeader) + n * 2 * sizeof(double) + (n + 1 + 2 * arcs) * sizeof(int) +
+                            (n + 1) * sizeof(uint32_t) + n + header->nameBytes;
+    if (header->magic != NETWORK_MAGIC || header->version != NETWORK_FORMAT_VERSION ||
+        (uint64_t)info.st_size != expectedSize) {
+        cerr << "Network file " << path << " is not a version " << NETWORK_FORMAT_VERSION << " .rnet file\n";
+        munmap(mapped, info.st_size);
+        return false;
+    }
+
+    const double* latitude = (const double*)(base + sizeof(NetworkFileHeader));
+    const double* longitude = latitude + n;
+    const int* offsets = (const int*)(longitude + n);
+    const int* neighbors = offsets + n + 1;
+    const int* weights = neighbors + arcs;
+    const uint32_t* nameOffsets = (const uint32_t*)(weights + arcs);
+    const uint8_t* hasCoordinates = (const uint8_t*)(nameOffsets + n + 1);
+    const char* names = (const char*)(hasCoordinates + n);
+
+    bool consistent = offsets[0] == 0 && offsets[n] == arcs && nameOffsets[n] == header->nameBytes;
+    for (int i = 0; consistent && i < n; i++) {
+        consistent = offsets[i] <= offsets[i + 1] && nameOffsets[i] <= nameOffsets[i + 1];
+    }
+    for (int j = 0; consistent && j < arcs; j++) {
+        consistent = neighbors[j] >= 0 && neighbors[j] < n && weights[j] > 0;
+    }
+    // Every connection is stored from both ends with the same distance
+    if (consistent) {
+        vector<pair<int, int> > sortedArcs(arcs); // (neighbor, distance), sorted per station
+        for (int u = 0; u < n; u++) {
+            for (int j = offsets[u]; j < offsets[u + 1]; j++) sortedArcs[j] = make_pair(neighbors[j], weights[j]);
+            sort(sortedArcs.begin() + offsets[u], sortedArcs.begin() + offsets[u + 1]);
+        }
+        for (int u = 0; consistent && u < n; u++) {
+            for (int j = offsets[u]; consistent && j < offsets[u + 1]; j++) {
+                int v = neighbors[j];
+                consistent = binary_search(sortedArcs.begin() + offsets[v], sortedArcs.begin() + offsets[v + 1],
+                                           make_pair(u, weights[j]));
+            }
+        }
+    }
+    if (!consistent) {
+        cerr << "Network file " << path << " is corrupt\n";
+        munmap(mapped, info.st_size);
+        return false;
+    }
+
+    stations.clear();
+    stations.resize(n);
+    segmentIds.clear();
+    for (int i = 0; i < n; i++) {
+        Station& station = stations[i];
+        station.name.assign(names + nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i]);
+        station.latitude = latitude[i];
+        station.longitude = longitude[i];
+        station.hasCoordinates = hasCoordinates[i];
+        station.connections.resize(offsets[i + 1] - offsets[i]);
+        for (int j = offsets[i]; j < offsets[i + 1]; j++) {
+            station.connections[j - offsets[i]] = make_pair(neighbors[j], weights[j]);
+            if (i < neighbors[j]) registerSegment(i, neighbors[j]);
+        }
+    }
+
+    stationGraph.stationCount = n;
+    stationGraph.offsets.assign(offsets, offsets + n + 1);
+    stationGraph.neighbors.assign(neighbors, neighbors + arcs);
+    stationGraph.weights.assign(weights, weights + arcs);
+    // The stored scale is not trusted: a wrong one would make A* return longer routes
+    computeHeuristicScale(stations, stationGraph);
+    graphVersion++;
+    stationGraph.version = graphVersion;
+    munmap(mapped, info.st_size);
+    return true;
+}
+
+// Load a network file, choosing the reader from the file's first bytes
+bool loadNetwork(const string& path) {
+    uint32_t magic = 0;
+    ifstream probe(path.c_str(), ios::binary);
+    probe.read((char*)&magic, sizeof(magic));
+    probe.close();
+    return magic == NETWORK_MAGIC ? loadNetworkBinary(path) : loadNetworkText(path);
+}
+
+// Fare Rules
+//
+// A tariff gives each class telescopic distance slabs (every km inside a slab costs that
+// slab's rate, so long journeys get cheaper per km), a minimum fare and a flat surcharge
+// per ticket, plus age concessions taken off the total. The built-in tariff is a constexpr
+// table with the original flat per-km rates; --tariff loads another one from a file.
+// Slab arrays have a fixed length, so the batch pricer's loops have compile-time trip
+// counts and vectorize.
+const int MAX_FARE_SLABS = 8;
+const int MAX_CONCESSIONS = 8;
+const int MAX_FARE_DISTANCE = 200000;  // km; longer distances are priced as this
+const int MAX_PAISE_PER_KM = 10000;    // with the above, a fare in paise fits in 32 bits
+
+struct ClassTariff {
+    int slabStart[MAX_FARE_SLABS];  // km at which each slab begins
+    int slabWidth[MAX_FARE_SLABS];  // km it covers; 0 for unused slabs
+    int paisePerKm[MAX_FARE_SLABS];
+    int minimumFare;                // rupees, before the surcharge
+    int surcharge;                  // rupees per ticket
+};
+
+struct AgeConcession {
+    int minAge;
+    int maxAge;
+    int percentOff;
+    char name[24];
+};
+
+struct Tariff {
+    ClassTariff classes[FIRST_CLASS + 1]; // indexed by TicketClass; [0] is unused
+    int concessionCount;
+    AgeConcession concessions[MAX_CONCESSIONS]; // the first one covering a passenger's age applies
+};
+
+constexpr ClassTariff flatClassTariff(int paisePerKm) {
+    ClassTariff rule = {};
+    rule.slabWidth[0] = MAX_FARE_DISTANCE;
+    rule.paisePerKm[0] = paisePerKm;
+    return rule;
+}
+
+constexpr Tariff DEFAULT_TARIFF = {
+    { ClassTariff(), flatClassTariff(200), flatClassTariff(300), flatClassTariff(500), flatClassTariff(800) },
+    0, {}
+};
+
+// Fare in rupees for one class, before concessions
+constexpr int classFare(const ClassTariff& rule, int distance) {
+    distance = min(distance, MAX_FARE_DISTANCE);
+    int paise = 0;
+    for (int s = 0; s < MAX_FARE_SLABS; s++) {
+        paise += min(max(distance - rule.slabStart[s], 0), rule.slabWidth[s]) * rule.paisePerKm[s];
+    }
+    return max((paise + 50) / 100, rule.minimumFare) + rule.surcharge;
+}
+
+static_assert(classFare(DEFAULT_TARIFF.classes[AC], 100) == 500, "built-in AC fare is 5 per km");
+
+Tariff tariff = DEFAULT_TARIFF;
+
+// Fare in rupees for one class, before concessions
+int getFareForClass(int distance, TicketClass ticketClass) {
+    if (ticketClass < GENERAL || ticketClass > FIRST_CLASS) ticketClass = GENERAL;
+    return classFare(tariff.classes[ticketClass], distance);
+}
+
+// Concession for a passenger of this age, or null
+const AgeConcession* findConcession(int age) {
+    for (int i = 0; i < tariff.concessionCount; i++) {
+        if (age >= tariff.concessions[i].minAge && age <= tariff.concessions[i].maxAge) return &tariff.concessions[i];
+    }
+    return NULL;
+}
+
+// Fare in rupees for one passenger, after any age concession
+int getPassengerFare(int distance, TicketClass ticketClass, int age) {
+    int fare = getFareForClass(distance, ticketClass);
+    const AgeConcession* concession = findConcession(age);
+    if (concession == NULL) return fare;
+    return (fare * (100 - concession->percentOff) + 50) / 100;
+}
+
+// Fares of a batch of distances, one column per class
+struct FareColumns {
+    vector<int> byClass[FIRST_CLASS + 1]; // byClass[c][i] is the fare of distance i in class c, -1 if unreachable
+};
+
+// Price every distance in all four classes in one pass. Distances are copied into a
+// fixed-size block (the last one padded), so every loop below has a constant trip count
+void priceDistances(const Tariff& rules, const int* distance, size_t count, FareColumns& fares) {
+    const int BLOCK = 256;
+    int blockDistance[BLOCK];
+    int clamped[BLOCK];
+    int paise[BLOCK];
+    int blockFare[BLOCK];
+    for (int c = GENERAL; c <= FIRST_CLASS; c++) fares.byClass[c].resize(count);
+
+    for (size_t begin = 0; begin < count; begin += BLOCK) {
+        size_t length = min((size_t)BLOCK, count - begin);
+        memcpy(blockDistance, distance + begin, length * sizeof(int));
+        if (length < BLOCK) memset(blockDistance + length, 0, (BLOCK - length) * sizeof(int));
+        for (int i = 0; i < BLOCK; i++) {
+            int d = blockDistance[i] < 0 ? 0 : blockDistance[i];
+            clamped[i] = d > MAX_FARE_DISTANCE ? MAX_FARE_DISTANCE : d;
+        }
+
+        for (int c = GENERAL; c <= FIRST_CLASS; c++) {
+            const ClassTariff& rule = rules.classes[c];
+            memset(paise, 0, sizeof(paise));
+            for (int s = 0; s < MAX_FARE_SLABS; s++) {
+                int start = rule.slabStart[s], width = rule.slabWidth[s], rate = rule.paisePerKm[s];
+                if (width == 0) continue;
+                for (int i = 0; i < BLOCK; i++) {
+                    int km = clamped[i] - start;
+                    km = km < 0 ? 0 : km;
+                    paise[i] += (km > width ? width : km) * rate;
+                }
+            }
+            int minimum = rule.minimumFare, surcharge = rule.surcharge;
+            for (int i = 0; i < BLOCK; i++) {
+                int fare = (paise[i] + 50) / 100;
+                fare = (fare < minimum ? minimum : fare) + surcharge;
+                blockFare[i] = blockDistance[i] < 0 ? -1 : fare;
+            }
+            memcpy(&fares.byClass[c][begin], blockFare, length * sizeof(int));
+        }
+    }
+}
+
+// Tariff files are CSV or TSV, one rule per line ('#' starts a comment):
+//   S,<class 1-4>,<up to km or *>,<paise per km>     the next distance slab of a class
+//   F,<class 1-4>,<minimum fare>,<surcharge>          class-wide charges in rupees
+//   A,<min age>,<max age>,<percent off>,<name>        an age concession
+// Each class needs its slabs in increasing order, the last one open-ended (*).
+// Concessions are tried in file order and the first that covers the age applies.
+bool loadTariff(const string& path) {
+    ifstream in(path.c_str(), ios::binary);
+    if (!in) {
+        cerr << "Cannot open tariff file " << path << "\n";
+        return false;
+    }
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    Tariff loaded = {};
+    int slabCount[FIRST_CLASS + 1] = {};
+    bool openEnded[FIRST_CLASS + 1] = {};
+    vector<string> fields;
+    int lineNumber = 0;
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == string::npos) lineEnd = text.size();
+        lineNumber++;
+        splitNetworkLine(text.data() + lineStart, text.data() + lineEnd, fields);
+        lineStart = lineEnd + 1;
+        if (fields[0].empty() || fields[0][0] == '#') continue;
+
+        int ticketClass = fields.size() == 4 ? atoi(fields[1].c_str()) : 0;
+        bool validClass = ticketClass >= GENERAL && ticketClass <= FIRST_CLASS;
+        if ((fields[0] == "S" || fields[0] == "s") && validClass) {
+            ClassTariff& rule = loaded.classes[ticketClass];
+            int s = slabCount[ticketClass];
+            int start = s == 0 ? 0 : rule.slabStart[s - 1] + rule.slabWidth[s - 1];
+            int end = fields[2] == "*" ? MAX_FARE_DISTANCE : atoi(fields[2].c_str());
+            int rate = atoi(fields[3].c_str());
+            if (openEnded[ticketClass] || s == MAX_FARE_SLABS || end <= start || end > MAX_FARE_DISTANCE ||
+                rate < 0 || rate > MAX_PAISE_PER_KM) {
+                cerr << path << ":" << lineNumber << ": slabs must increase, end with *, number at most "
+                     << MAX_FARE_SLABS << " per class and cost 0-" << MAX_PAISE_PER_KM << " paise per km\n";
+                return false;
+            }
+            rule.slabStart[s] = start;
+            rule.slabWidth[s] = end - start;
+            rule.paisePerKm[s] = rate;
+            slabCount[ticketClass]++;
+            openEnded[ticketClass] = fields[2] == "*";
+        } else if ((fields[0] == "F" || fields[0] == "f") && validClass) {
+            int minimum = atoi(fields[2].c_str()), surcharge = atoi(fields[3].c_str());
+            if (minimum < 0 || surcharge < 0 || minimum > 100000 || surcharge > 100000) {
+                cerr << path << ":" << lineNumber << ": minimum fare and surcharge must be 0-100000\n";
+                return false;
+            }
+            loaded.classes[ticketClass].minimumFare = minimum;
+            loaded.classes[ticketClass].surcharge = surcharge;
+        } else if ((fields[0] == "A" || fields[0] == "a") && fields.size() == 5) {
+            int minAge = atoi(fields[1].c_str()), maxAge = atoi(fields[2].c_str());
+            int percentOff = atoi(fields[3].c_str());
+            if (loaded.concessionCount == MAX_CONCESSIONS || minAge < 0 || maxAge < minAge || percentOff < 0 ||
+                percentOff > 100 || fields[4].empty() || fields[4].size() >= sizeof(AgeConcession().name)) {
+                cerr << path << ":" << lineNumber << ": at most " << MAX_CONCESSIONS
+                     << " concessions, each with an age range, 0-100 percent off and a short name\n";
+                return false;
+            }
+            AgeConcession& concession = loaded.concessions[loaded.concessionCount++];
+            concession.minAge = minAge;
+            concession.maxAge = maxAge;
+            concession.percentOff = percentOff;
+            strcpy(concession.name, fields[4].c_str());
+        } else {
+            cerr << path << ":" << lineNumber << ": expected S,class,km,paise or F,class,minimum,surcharge"
+                 << " or A,min age,max age,percent,name\n";
             return false;
         }
     }
-    
-    cout << "Enter password: ";
-    cin >> password;
-    
-    User newUser;
-    newUser.username = username;
-    newUser.password = password;
-    users.push_back(newUser);
-    
-    cout << "Registration successful! You can now login.\n";
+    for (int c = GENERAL; c <= FIRST_CLASS; c++) {
+        if (!openEnded[c]) {
+            cerr << path << ": class " << c << " needs slabs ending with an open-ended (*) one\n";
+            return false;
+        }
+    }
+    tariff = loaded;
     return true;
 }
 
-bool loginUser() {
-    string username, password;
-    cout << "\n=== User Login ===\n";
-    cout << "Enter username: ";
-    cin >> username;
-    cout << "Enter password: ";
-    cin >> password;
-    
-    for (int i = 0; i < users.size(); i++) {
-        if (users[i].username == username && users[i].password == password) {
-            currentUser = username;
-            cout << "Login successful! Welcome " << username << "!\n";
-            return true;
+// Console Output
+//
+// Listings and confirmations are assembled in one reusable buffer and go out in a single
+// write() per response, rather than through many cout << endl calls that each flush.
+// Numbers are formatted by hand. With --output=json every response is instead one JSON
+// object on its own line of stdout, and menus, prompts and errors move to stderr.
+
+bool writeFully(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+// Appends into one large buffer and writes it out in big blocks
+struct OutputBuffer {
+    int fd;
+    vector<char> bytes;
+    bool failed;
+
+    OutputBuffer(int output) : fd(output), failed(false) { bytes.reserve(1 << 20); }
+
+    void append(const char* data, size_t length) {
+        bytes.insert(bytes.end(), data, data + length);
+        if (bytes.size() >= (1 << 20)) flush();
+    }
+
+    void append(const char* text) { append(text, strlen(text)); }
+
+    void append(const string& text) { append(text.data(), text.size()); }
+
+    void appendInt(long long value) {
+        char digits[24];
+        char* end = digits + sizeof(digits);
+        char* at = end;
+        bool negative = value < 0;
+        unsigned long long magnitude = negative ? -(unsigned long long)value : value;
+        do {
+            *--at = '0' + magnitude % 10;
+            magnitude /= 10;
+        } while (magnitude > 0);
+        if (negative) *--at = '-';
+        append(at, end - at);
+    }
+
+    void appendChar(char c) { append(&c, 1); }
+
+    // A JSON string literal, with quotes, backslashes and control characters escaped
+    void appendJsonString(const char* text, size_t length) {
+        appendChar('"');
+        size_t plain = 0;
+        for (size_t i = 0; i < length; i++) {
+            unsigned char c = text[i];
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+            append(text + plain, i - plain);
+            plain = i + 1;
+            if (c == '"' || c == '\\') {
+                appendChar('\\');
+                appendChar(c);
+            } else {
+                const char* hex = "0123456789abcdef";
+                char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+                append(escaped, sizeof(escaped));
+            }
+        }
+        append(text + plain, length - plain);
+        appendChar('"');
+    }
+
+    bool flush() {
+        if (!bytes.empty() && !failed) failed = !writeFully(fd, bytes.data(), bytes.size());
+        bytes.clear();
+        return !failed;
+    }
+};
+
+// Writes one JSON value into an OutputBuffer, putting in the commas between members
+struct JsonWriter {
+    static const int MAX_DEPTH = 8;
+    OutputBuffer& out;
+    bool hasMembers[MAX_DEPTH]; // whether the open object or array at each depth has a member yet
+    int depth;
+    bool afterKey;
+
+    JsonWriter(OutputBuffer& buffer) : out(buffer), depth(0), afterKey(false) { hasMembers[0] = false; }
+
+    void beginValue() {
+        if (afterKey) {
+            afterKey = false;
+            return;
         }
+        if (hasMembers[depth]) out.appendChar(',');
+        hasMembers[depth] = true;
+    }
+
+    JsonWriter& key(const char* name) {
+        beginValue();
+        out.appendJsonString(name, strlen(name));
+        out.appendChar(':');
+        afterKey = true;
+        return *this;
+    }
+
+    void open(char bracket) {
+        beginValue();
+        out.appendChar(bracket);
+        hasMembers[++depth] = false;
+    }
+
+    void close(char bracket) {
+        out.appendChar(bracket);
+        depth--;
+    }
+
+    void integer(long long value) {
+        beginValue();
+        out.appendInt(value);
+    }
+
+    void text(const string& value) {
+        beginValue();
+        out.appendJsonString(value.data(), value.size());
+    }
+
+    void text(const char* value) {
+        beginValue();
+        out.appendJsonString(value, strlen(value));
+    }
+
+    void boolean(bool value) {
+        beginValue();
+        out.append(value ? "true" : "false");
+    }
+
+    // Start a response object with its "type" member
+    void beginResponse(const char* type) {
+        open('{');
+        key("type").text(type);
+    }
+
+    // Close the response object and end its line
+    void endResponse() {
+        close('}');
+        out.appendChar('\n');
+    }
+};
+
+OutputBuffer screen(STDOUT_FILENO);
+bool jsonOutput = false; // --output=json
+
+// Send the response built up in screen; cout is flushed first so prompts written before it stay in order
+void finishResponse() {
+    cout.flush();
+    screen.flush();
+}
+
+// Station names along a route, joined by arrows
+void appendRoutePath(OutputBuffer& out, const vector<int>& path) {
+    for (int i = 0; i < path.size(); i++) {
+        if (i > 0) out.append(" -> ", 4);
+        out.append(stations[path[i]].name);
+    }
+}
+
+void appendJsonPath(JsonWriter& json, const vector<int>& path) {
+    json.open('[');
+    for (int i = 0; i < path.size(); i++) json.text(stations[path[i]].name);
+    json.close(']');
+}
+
+// Stations from src to dest in a predecessor tree, walked backwards into scratch; empty if unreachable
+void collectTreePath(const vector<int>& prev, int dest, int src, vector<int>& scratch) {
+    scratch.clear();
+    if (dest != src && prev[dest] == -1) return;
+    for (int at = dest; at != src; at = prev[at]) scratch.push_back(at);
+    scratch.push_back(src);
+    reverse(scratch.begin(), scratch.end());
+}
+
+// "H hours M minutes" for a travel time
+void appendTravelTime(OutputBuffer& out, const TimeInfo& timeInfo) {
+    out.appendInt((int)timeInfo.hours);
+    out.append(" hours ");
+    out.appendInt((int)timeInfo.minutes);
+    out.append(" minutes");
+}
+
+void displayStations() {
+    if (jsonOutput) {
+        JsonWriter json(screen);
+        json.beginResponse("stations");
+        json.key("stations").open('[');
+        for (int i = 0; i < stations.size(); i++) {
+            json.open('{');
+            json.key("index").integer(i);
+            json.key("name").text(stations[i].name);
+            json.close('}');
+        }
+        json.close(']');
+        json.endResponse();
+    } else {
+        screen.append("\nAvailable Stations:\n");
+        for (int i = 0; i < stations.size(); i++) {
+            screen.appendInt(i);
+            screen.append(". ", 2);
+            screen.append(stations[i].name);
+            screen.appendChar('\n');
+        }
+    }
+    finishResponse();
+}
+
+string getClassString(TicketClass ticketClass) {
+    switch(ticketClass) {
+        case GENERAL: return "General";
+        case SLEEPER: return "Sleeper";
+        case AC: return "AC";
+        case FIRST_CLASS: return "First Class";
+        default: return "General";
+    }
+}
+
+// Rupees for an amount in paise: "2" for 200, "1.60" for 160
+string formatPaise(int paise) {
+    char text[16];
+    if (paise % 100 == 0) {
+        snprintf(text, sizeof(text), "%d", paise / 100);
+    } else {
+        snprintf(text, sizeof(text), "%d.%02d", paise / 100, paise % 100);
+    }
+    return text;
+}
+
+void displayFareOptions() {
+    cout << "\nTicket Classes:\n";
+    for (int c = GENERAL; c <= FIRST_CLASS; c++) {
+        const ClassTariff& rule = tariff.classes[c];
+        cout << c << ". " << getClassString((TicketClass)c) << " (₹" << formatPaise(rule.paisePerKm[0]) << " per km";
+        if (rule.slabWidth[1] > 0) cout << " for the first " << rule.slabWidth[0] << " km, less beyond";
+        if (rule.minimumFare > 0) cout << ", minimum ₹" << rule.minimumFare;
+        if (rule.surcharge > 0) cout << ", plus ₹" << rule.surcharge << " per ticket";
+        cout << ")\n";
+    }
+    for (int i = 0; i < tariff.concessionCount; i++) {
+        const AgeConcession& concession = tariff.concessions[i];
+        cout << (i == 0 ? "Concessions: " : ", ") << concession.name << " (age " << concession.minAge << "-"
+             << concession.maxAge << ") " << concession.percentOff << "% off";
+        if (i + 1 == tariff.concessionCount) cout << "\n";
+    }
+}
+
+void calculateFare(int distance, TicketClass ticketClass) {
+    TimeInfo timeInfo(distance);
+    if (jsonOutput) {
+        JsonWriter json(screen);
+        json.beginResponse("fare");
+        json.key("distance_km").integer(distance);
+        json.key("travel_minutes").integer(timeInfo.totalMinutes());
+        json.key("class").text(getClassString(ticketClass));
+        json.key("fare").integer(getFareForClass(distance, ticketClass));
+        json.key("fares").open('{');
+        for (int c = GENERAL; c <= FIRST_CLASS; c++) {
+            json.key(getClassString((TicketClass)c).c_str()).integer(getFareForClass(distance, (TicketClass)c));
+        }
+        json.close('}');
+        json.endResponse();
+        finishResponse();
+        return;
+    }
+
+    screen.append("\n=== Route Information ===\nDistance: ");
+    screen.appendInt(distance);
+    screen.append(" km\nEstimated Travel Time: ");
+    appendTravelTime(screen, timeInfo);
+    screen.append("\nTicket Class: ");
+    screen.append(getClassString(ticketClass));
+    screen.append("\nFare: ₹");
+    screen.appendInt(getFareForClass(distance, ticketClass));
+    screen.append("\n\nAll Fare Options:\n");
+    for (int c = GENERAL; c <= FIRST_CLASS; c++) {
+        screen.append(getClassString((TicketClass)c));
+        screen.append(": ₹");
+        screen.appendInt(getFareForClass(distance, (TicketClass)c));
+        screen.appendChar('\n');
+    }
+    finishResponse();
+}
+
+// Persistence Functions
+//
+// Every register/book/cancel is appended to a write-ahead journal. A background
+// thread writes and fsyncs whatever accumulated since its previous flush, so all
+// events that arrive during one fsync share the next one (group commit).
+// Record layout: u32 payload length, payload (u8 event type first), u32 FNV-1a checksum.
+
+enum JournalEvent {
+    EVENT_REGISTER = 1,
+    EVENT_BOOK = 2,
+    EVENT_CANCEL = 3
+};
+
+const uint32_t JOURNAL_MAGIC = 0x4C4A5752; // "RWJL"
+const uint32_t SNAPSHOT_MAGIC = 0x4E535752; // "RWSN"
+const uint32_t PERSISTENCE_FORMAT_VERSION = 2; // 2 added train, travel day and route to bookings
+const uint32_t OLDEST_PERSISTENCE_VERSION = 1;  // still readable; upgraded by the next snapshot
+
+uint32_t checksumBytes(const char* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+    return hash;
+}
+
+// Little helpers to build and parse journal payloads
+struct RecordWriter {
+    vector<char> bytes;
+
+    template <typename T> void put(T value) {
+        const char* raw = (const char*)&value;
+        bytes.insert(bytes.end(), raw, raw + sizeof(T));
+    }
+
+    void putString(const string& text) {
+        put<uint32_t>(text.size());
+        bytes.insert(bytes.end(), text.begin(), text.end());
+    }
+};
+
+struct RecordReader {
+    const char* at;
+    const char* end;
+
+    RecordReader(const char* begin, const char* finish) : at(begin), end(finish) {}
+
+    template <typename T> bool get(T& value) {
+        if (end - at < (ptrdiff_t)sizeof(T)) return false;
+        memcpy(&value, at, sizeof(T));
+        at += sizeof(T);
+        return true;
+    }
+
+    bool getString(string& text) {
+        uint32_t length;
+        if (!get(length) || end - at < (ptrdiff_t)length) return false;
+        text.assign(at, length);
+        at += length;
+        return true;
+    }
+};
+
+struct Journal {
+    atomic<int> fd; // workers check isOpen while a snapshot closes and reopens the file
+    mutex lock;
+    condition_variable dataReady; // wakes the flusher
+    condition_variable flushed;   // wakes writers waiting for durability
+    vector<char> pending;
+    long long appendedRecords;
+    long long durableRecords;
+    long long lostRecords; // records up to this sequence were queued to a journal that failed
+    atomic<long long> recordsSinceSnapshot; // read by snapshotDue without the lock
+    bool stopping;
+    bool failed;           // a write or fdatasync failed since the journal was opened
+    thread flusher;
+
+    Journal() : fd(-1), appendedRecords(0), durableRecords(0), lostRecords(0), recordsSinceSnapshot(0),
+                stopping(false), failed(false) {}
+
+    bool isOpen() const { return fd != -1; }
+
+    // Open for appending at `validLength` (dropping any torn tail), or start a fresh
+    // journal for `generation` when validLength is 0. Callers only pass 0 when there is
+    // no journal yet or everything in it is already in a durable snapshot.
+    bool open(const string& path, uint32_t generation, off_t validLength) {
+        int file = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (file == -1) return false;
+        if (validLength == 0) {
+            uint32_t header[3] = { JOURNAL_MAGIC, PERSISTENCE_FORMAT_VERSION, generation };
+            if (ftruncate(file, 0) != 0 || !writeFully(file, (const char*)header, sizeof(header)) ||
+                fsync(file) != 0) {
+                ::close(file);
+                return false;
+            }
+        } else if (ftruncate(file, validLength) != 0 || lseek(file, validLength, SEEK_SET) != validLength) {
+            ::close(file);
+            return false;
+        }
+        {
+            // A failure in the previous file stays with the records that went to it
+            lock_guard<mutex> guard(lock);
+            if (failed) lostRecords = appendedRecords;
+            failed = false;
+        }
+        stopping = false;
+        fd = file;
+        flusher = thread(&Journal::flushLoop, this);
+        return true;
+    }
+
+    // Queue one event; returns its sequence number for waitDurable
+    long long append(const RecordWriter& record) {
+        uint32_t length = record.bytes.size();
+        uint32_t checksum = checksumBytes(record.bytes.data(), length);
+        lock_guard<mutex> guard(lock);
+        const char* rawLength = (const char*)&length;
+        const char* rawChecksum = (const char*)&checksum;
+        pending.insert(pending.end(), rawLength, rawLength + sizeof(length));
+        pending.insert(pending.end(), record.bytes.begin(), record.bytes.end());
+        pending.insert(pending.end(), rawChecksum, rawChecksum + sizeof(checksum));
+        recordsSinceSnapshot++;
+        long long sequence = ++appendedRecords;
+        dataReady.notify_one();
+        return sequence;
+    }
+
+    // Block until every record up to `sequence` has been fsynced; false if that record
+    // may not have reached disk
+    bool waitDurable(long long sequence) {
+        unique_lock<mutex> guard(lock);
+        while (durableRecords < sequence && !failed) flushed.wait(guard);
+        return !failed && sequence > lostRecords;
+    }
+
+    bool waitDurable() {
+        long long sequence;
+        {
+            lock_guard<mutex> guard(lock);
+            sequence = appendedRecords;
+        }
+        return waitDurable(sequence);
+    }
+
+    void flushLoop() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            while (pending.empty() && !stopping) dataReady.wait(guard);
+            if (pending.empty()) break;
+
+            vector<char> batch;
+            batch.swap(pending);
+            long long upTo = appendedRecords;
+            guard.unlock();
+            bool ok = writeFully(fd, batch.data(), batch.size()) && fdatasync(fd) == 0;
+            guard.lock();
+            if (!ok && !failed) {
+                failed = true;
+                cerr << "Journal write failed: " << strerror(errno) << "\n";
+            }
+            durableRecords = upTo;
+            flushed.notify_all();
+        }
+    }
+
+    void close() {
+        if (fd == -1) return;
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+            dataReady.notify_one();
+        }
+        flusher.join();
+        ::close(fd);
+        fd = -1;
+    }
+};
+
+Journal journal;
+string dataDirectory = "";           // --data-dir; empty keeps everything in memory
+long long snapshotInterval = 100000; // journal records between automatic snapshots
+bool replayingJournal = false;       // set while recovering so replayed events are not journaled again
+uint32_t journalGeneration = 0;
+
+// The journal* functions queue one event and return its sequence number for syncJournal,
+// or 0 when nothing was journaled
+long long journalRegister(const string& username, const string& password) {
+    if (!journal.isOpen() || replayingJournal) return 0;
+    RecordWriter record;
+    record.put<uint8_t>(EVENT_REGISTER);
+    record.putString(username);
+    record.putString(password);
+    return journal.append(record);
+}
+
+long long journalBooking(int ticketNumber, int userId, const string& passengerName, int age, int fromStation,
+                         int toStation, TicketClass ticketClass, int distance, int fare, int train, int travelDay,
+                         const vector<int>& route) {
+    if (!journal.isOpen() || replayingJournal) return 0;
+    RecordWriter record;
+    record.put<uint8_t>(EVENT_BOOK);
+    record.put<int32_t>(ticketNumber);
+    record.put<int32_t>(userId);
+    record.putString(passengerName);
+    record.put<uint8_t>(age);
+    record.put<uint16_t>(fromStation);
+    record.put<uint16_t>(toStation);
+    record.put<uint8_t>(ticketClass);
+    record.put<uint32_t>(distance);
+    record.put<uint32_t>(fare);
+    record.put<uint32_t>(train);
+    record.put<uint16_t>(travelDay);
+    record.put<uint32_t>(route.size());
+    for (int i = 0; i < route.size(); i++) record.put<uint16_t>(route[i]);
+    return journal.append(record);
+}
+
+long long journalCancel(int userId, int ticketNumber) {
+    if (!journal.isOpen() || replayingJournal) return 0;
+    RecordWriter record;
+    record.put<uint8_t>(EVENT_CANCEL);
+    record.put<int32_t>(userId);
+    record.put<int32_t>(ticketNumber);
+    return journal.append(record);
+}
+
+// Wait for the caller's own journal record to reach disk before a change is confirmed to
+// the user. False means it may not have (the journal failed or was not open), and the
+// change must not be reported as saved.
+bool syncJournal(long long sequence) {
+    if (dataDirectory.empty()) return true;
+    return sequence > 0 && journal.waitDurable(sequence);
+}
+
+// Metrics
+//
+// Latency histograms for route queries, logins, bookings and cancellations, and the
+// effort of each route search, gathered with --metrics or --stats-file. Every thread
+// counts into its own block, so recording takes no lock and shares no cache line;
+// a report sums the blocks of all threads. With metrics off each probe is one branch.
+//
+// Histograms are log-linear like HdrHistogram: values below 32 ns get a bucket each,
+// and every power of two above that is split into 16 buckets, so a bucket is at most
+// 1/16 (6%) wide relative to its values, from nanoseconds up to about 18 minutes.
+
+enum MetricOperation {
+    METRIC_ROUTE,
+    METRIC_LOGIN,
+    METRIC_BOOK,
+    METRIC_CANCEL,
+    METRIC_OPERATION_COUNT
+};
+
+const char* const METRIC_OPERATION_NAMES[METRIC_OPERATION_COUNT] = { "route", "login", "book", "cancel" };
+
+enum SearchKind {
+    SEARCH_DIJKSTRA,
+    SEARCH_ASTAR,
+    SEARCH_CH,
+    SEARCH_TREE, // single-source shortest-path trees for the listings
+    SEARCH_KIND_COUNT
+};
+
+const char* const SEARCH_KIND_NAMES[SEARCH_KIND_COUNT] = { "dijkstra", "astar", "ch", "single-source" };
+
+const int LATENCY_SUB_BITS = 4;
+const int LATENCY_SUB_BUCKETS = 1 << LATENCY_SUB_BITS;
+const int LATENCY_MAX_BITS = 40;
+const int LATENCY_BUCKETS = (LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS;
+
+int latencyBucket(uint64_t nanos) {
+    if (nanos < 2 * LATENCY_SUB_BUCKETS) return nanos;
+    if (nanos >> LATENCY_MAX_BITS) return LATENCY_BUCKETS - 1;
+    int shift = 63 - __builtin_clzll(nanos) - LATENCY_SUB_BITS;
+    return (shift + 1) * LATENCY_SUB_BUCKETS + (int)(nanos >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+// Largest value that falls into a bucket
+uint64_t latencyBucketLimit(int bucket) {
+    if (bucket < 2 * LATENCY_SUB_BUCKETS) return bucket;
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    return ((uint64_t)(bucket % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS + 1) << shift) - 1;
+}
+
+// Counters of one thread. Only the owning thread writes them, so a relaxed load and
+// store is enough; reports read them from other threads while they change.
+struct ThreadMetrics {
+    atomic<uint64_t> operations[METRIC_OPERATION_COUNT];
+    atomic<uint64_t> totalNanos[METRIC_OPERATION_COUNT];
+    atomic<uint64_t> maxNanos[METRIC_OPERATION_COUNT];
+    atomic<uint32_t> latency[METRIC_OPERATION_COUNT][LATENCY_BUCKETS];
+    atomic<uint64_t> searches[SEARCH_KIND_COUNT];
+    atomic<uint64_t> settledNodes[SEARCH_KIND_COUNT];
+    atomic<uint64_t> relaxedEdges[SEARCH_KIND_COUNT];
+    atomic<uint64_t> heapPushes[SEARCH_KIND_COUNT];
+};
+
+bool metricsEnabled = false; // --metrics or --stats-file
+mutex metricsLock;
+vector<ThreadMetrics*> metricsThreads; // every block ever handed out; kept after its thread exits
+
+template <typename T> void addCounter(atomic<T>& counter, T amount) {
+    counter.store(counter.load(memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+ThreadMetrics& threadMetrics() {
+    thread_local ThreadMetrics* metrics = NULL;
+    if (metrics == NULL) {
+        metrics = new ThreadMetrics(); // value-initialized, so every counter starts at zero
+        lock_guard<mutex> guard(metricsLock);
+        metricsThreads.push_back(metrics);
+    }
+    return *metrics;
+}
+
+void recordLatency(MetricOperation operation, uint64_t nanos) {
+    ThreadMetrics& metrics = threadMetrics();
+    addCounter<uint64_t>(metrics.operations[operation], 1);
+    addCounter<uint64_t>(metrics.totalNanos[operation], nanos);
+    if (nanos > metrics.maxNanos[operation].load(memory_order_relaxed)) {
+        metrics.maxNanos[operation].store(nanos, memory_order_relaxed);
+    }
+    addCounter<uint32_t>(metrics.latency[operation][latencyBucket(nanos)], 1);
+}
+
+void recordSearch(SearchKind kind, long long settled, long long relaxed, long long pushes) {
+    if (!metricsEnabled) return;
+    ThreadMetrics& metrics = threadMetrics();
+    addCounter<uint64_t>(metrics.searches[kind], 1);
+    addCounter<uint64_t>(metrics.settledNodes[kind], settled);
+    addCounter<uint64_t>(metrics.relaxedEdges[kind], relaxed);
+    addCounter<uint64_t>(metrics.heapPushes[kind], pushes);
+}
+
+// Times one operation from construction until stop(); does nothing while metrics are off
+struct OperationTimer {
+    MetricOperation operation;
+    bool running;
+    chrono::steady_clock::time_point start;
+
+    OperationTimer(MetricOperation op) : operation(op), running(metricsEnabled) {
+        if (running) start = chrono::steady_clock::now();
+    }
+
+    // Start over, e.g. after waiting on the user
+    void restart() {
+        if (running) start = chrono::steady_clock::now();
+    }
+
+    void stop() {
+        if (!running) return;
+        running = false;
+        recordLatency(operation, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    }
+};
+
+// Counters of all threads added together
+struct MetricsTotals {
+    uint64_t operations[METRIC_OPERATION_COUNT];
+    uint64_t totalNanos[METRIC_OPERATION_COUNT];
+    uint64_t maxNanos[METRIC_OPERATION_COUNT];
+    uint64_t latency[METRIC_OPERATION_COUNT][LATENCY_BUCKETS];
+    uint64_t searches[SEARCH_KIND_COUNT];
+    uint64_t settledNodes[SEARCH_KIND_COUNT];
+    uint64_t relaxedEdges[SEARCH_KIND_COUNT];
+    uint64_t heapPushes[SEARCH_KIND_COUNT];
+
+    // Latency in microseconds below which a fraction q of the operations fall
+    double percentileMicros(int operation, double q) const {
+        uint64_t rank = (uint64_t)ceil(q * operations[operation]);
+        uint64_t seen = 0;
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            seen += latency[operation][b];
+            if (seen >= rank && seen > 0) return min(latencyBucketLimit(b), maxNanos[operation]) / 1000.0;
+        }
+        return 0.0;
+    }
+
+    double meanMicros(int operation) const {
+        return operations[operation] == 0 ? 0.0 : totalNanos[operation] / 1000.0 / operations[operation];
+    }
+};
+
+void collectMetrics(MetricsTotals& totals) {
+    memset(&totals, 0, sizeof(totals));
+    lock_guard<mutex> guard(metricsLock);
+    for (int t = 0; t < metricsThreads.size(); t++) {
+        const ThreadMetrics& metrics = *metricsThreads[t];
+        for (int op = 0; op < METRIC_OPERATION_COUNT; op++) {
+            totals.operations[op] += metrics.operations[op].load(memory_order_relaxed);
+            totals.totalNanos[op] += metrics.totalNanos[op].load(memory_order_relaxed);
+            totals.maxNanos[op] = max(totals.maxNanos[op], (uint64_t)metrics.maxNanos[op].load(memory_order_relaxed));
+            for (int b = 0; b < LATENCY_BUCKETS; b++) {
+                totals.latency[op][b] += metrics.latency[op][b].load(memory_order_relaxed);
+            }
+        }
+        for (int kind = 0; kind < SEARCH_KIND_COUNT; kind++) {
+            totals.searches[kind] += metrics.searches[kind].load(memory_order_relaxed);
+            totals.settledNodes[kind] += metrics.settledNodes[kind].load(memory_order_relaxed);
+            totals.relaxedEdges[kind] += metrics.relaxedEdges[kind].load(memory_order_relaxed);
+            totals.heapPushes[kind] += metrics.heapPushes[kind].load(memory_order_relaxed);
+        }
+    }
+}
+
+void writeMetricsReport(ostream& out) {
+    MetricsTotals totals;
+    collectMetrics(totals);
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << "=== Metrics ===\n";
+    out << left << setw(14) << "Operation" << right << setw(10) << "Count" << setw(11) << "Mean us"
+        << setw(11) << "p50 us" << setw(11) << "p90 us" << setw(11) << "p99 us" << setw(11) << "p99.9 us"
+        << setw(11) << "Max us" << "\n";
+    out << fixed << setprecision(1);
+    for (int op = 0; op < METRIC_OPERATION_COUNT; op++) {
+        out << left << setw(14) << METRIC_OPERATION_NAMES[op] << right << setw(10) << totals.operations[op]
+            << setw(11) << totals.meanMicros(op) << setw(11) << totals.percentileMicros(op, 0.50)
+            << setw(11) << totals.percentileMicros(op, 0.90) << setw(11) << totals.percentileMicros(op, 0.99)
+            << setw(11) << totals.percentileMicros(op, 0.999) << setw(11) << totals.maxNanos[op] / 1000.0 << "\n";
+    }
+    out << "\n" << left << setw(14) << "Search" << right << setw(10) << "Queries" << setw(15) << "Settled/query"
+        << setw(15) << "Relaxed/query" << setw(15) << "Pushes/query" << "\n";
+    for (int kind = 0; kind < SEARCH_KIND_COUNT; kind++) {
+        double queries = max<uint64_t>(1, totals.searches[kind]);
+        out << left << setw(14) << SEARCH_KIND_NAMES[kind] << right << setw(10) << totals.searches[kind]
+            << setw(15) << totals.settledNodes[kind] / queries << setw(15) << totals.relaxedEdges[kind] / queries
+            << setw(15) << totals.heapPushes[kind] / queries << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+// User Management Functions
+
+StringPool userNames;
+
+// Open-addressing hash index from username to user ID (the position in users).
+// Linear probing over a power-of-two table kept at most half full; each slot keeps
+// the full hash so probes only compare strings on a likely match.
+struct UserIndex {
+    vector<uint32_t> hashes;
+    vector<int> ids; // -1 marks an empty slot
+    int count;
+
+    UserIndex() : count(0) {}
+
+    static uint32_t hashName(const char* name) {
+        uint32_t hash = 2166136261u;
+        for (; *name; name++) hash = (hash ^ (unsigned char)*name) * 16777619u;
+        return hash;
+    }
+
+    int find(const string& username) const {
+        if (count == 0) return -1;
+        uint32_t hash = hashName(username.c_str());
+        size_t mask = ids.size() - 1;
+        for (size_t slot = hash & mask; ids[slot] != -1; slot = (slot + 1) & mask) {
+            if (hashes[slot] == hash && username == userNames.get(users[ids[slot]].nameOffset)) {
+                return ids[slot];
+            }
+        }
+        return -1;
+    }
+
+    void insert(int id) {
+        if ((count + 1) * 2 > (int)ids.size()) grow();
+        placeEntry(hashName(userNames.get(users[id].nameOffset)), id);
+        count++;
+    }
+
+    void placeEntry(uint32_t hash, int id) {
+        size_t mask = ids.size() - 1;
+        size_t slot = hash & mask;
+        while (ids[slot] != -1) slot = (slot + 1) & mask;
+        hashes[slot] = hash;
+        ids[slot] = id;
+    }
+
+    void grow() {
+        vector<uint32_t> oldHashes;
+        vector<int> oldIds;
+        oldHashes.swap(hashes);
+        oldIds.swap(ids);
+        size_t capacity = max((size_t)16, oldIds.size() * 2);
+        hashes.assign(capacity, 0);
+        ids.assign(capacity, -1);
+        for (size_t i = 0; i < oldIds.size(); i++) {
+            if (oldIds[i] != -1) placeEntry(oldHashes[i], oldIds[i]);
+        }
+    }
+};
+
+UserIndex userIndex;
+
+const char* getUsername(int userId) {
+    return userNames.get(users[userId].nameOffset);
+}
+
+// Add a user and return its ID, or -1 if the username is taken; journaled receives the
+// journal sequence to pass to syncJournal
+int createUser(const string& username, const string& password, long long* journaled = NULL) {
+    if (userIndex.find(username) != -1) return -1;
+    User newUser;
+    newUser.nameOffset = userNames.add(username);
+    newUser.password = password;
+    users.push_back(newUser);
+    userIndex.insert(users.size() - 1);
+    long long sequence = journalRegister(username, password);
+    if (journaled != NULL) *journaled = sequence;
+    return users.size() - 1;
+}
+
+// User ID for matching credentials, or -1
+int authenticateUser(const string& username, const string& password) {
+    int userId = userIndex.find(username);
+    if (userId == -1 || users[userId].password != password) return -1;
+    return userId;
+}
+
+bool registerUser() {
+    string username, password;
+    cout << "\n=== User Registration ===\n";
+    cout << "Enter username: ";
+    cin >> username;
+    
+    // Check if username already exists
+    if (userIndex.find(username) != -1) {
+        cout << "Username already exists! Please choose a different username.\n";
+        return false;
+    }
+    
+    cout << "Enter password: ";
+    cin >> password;
+    
+    long long journaled = 0;
+    createUser(username, password, &journaled);
+    if (!syncJournal(journaled)) {
+        cout << "Registration could not be saved: the journal is unavailable.\n";
+        return false;
+    }
+    
+    cout << "Registration successful! You can now login.\n";
+    return true;
+}
+
+bool loginUser(Session& session) {
+    string username, password;
+    cout << "\n=== User Login ===\n";
+    cout << "Enter username: ";
+    cin >> username;
+    cout << "Enter password: ";
+    cin >> password;
+    
+    OperationTimer timer(METRIC_LOGIN);
+    int userId = authenticateUser(username, password);
+    timer.stop();
+    if (userId != -1) {
+        session.userId = userId;
+        cout << "Login successful! Welcome " << username << "!\n";
+        return true;
+    }
+    
+    cout << "Invalid username or password!\n";
+    return false;
+}
+
+void logoutUser(Session& session) {
+    session.userId = -1;
+    cout << "Logged out successfully!\n";
+}
+
+// Result of a point-to-point route query, filled in by the search itself
+struct RouteResult {
+    bool found;
+    int totalDistance;              // km, -1 when no route exists
+    vector<int> path;               // station indices from source to destination
+    vector<int> legDistances;       // km of each leg, path.size() - 1 entries
+    vector<double> cumulativeHours; // hours from source on arrival at each path station
+    int settledNodes;               // search effort, for comparing engines
+    int relaxedEdges;               // arcs scanned from settled stations
+    int heapPushes;
+
+    RouteResult() : found(false), totalDistance(-1), settledNodes(0), relaxedEdges(0), heapPushes(0) {}
+
+    // Back to "no route", keeping the vectors' storage for the next query
+    void clear() {
+        found = false;
+        totalDistance = -1;
+        path.clear();
+        legDistances.clear();
+        cumulativeHours.clear();
+        settledNodes = 0;
+        relaxedEdges = 0;
+        heapPushes = 0;
+    }
+};
+
+// Fill totalDistance and cumulativeHours of a route from its legs
+void finishRoute(RouteResult& result) {
+    result.found = true;
+    result.totalDistance = 0;
+    result.cumulativeHours.resize(result.path.size());
+    result.cumulativeHours[0] = 0.0;
+    for (int i = 0; i < result.legDistances.size(); i++) {
+        result.totalDistance += result.legDistances[i];
+        result.cumulativeHours[i + 1] = result.totalDistance / AVERAGE_SPEED_KMPH;
+    }
+}
+
+// Scratch space for point-to-point searches, one per thread (see searchWorkspace). An
+// entry is valid only while its stamp equals the current generation, so starting a search
+// costs nothing however large the network is, and once the arrays and heaps have grown to
+// the largest search seen, queries allocate nothing.
+struct SearchWorkspace {
+    // Side 0 searches from the source, side 1 backwards from the destination
+    vector<int> dist[2];
+    vector<int> prev[2];         // predecessor station, or the edge used for CH queries
+    vector<int> prevWeight[2];   // km of the arc prev -> station
+    vector<unsigned> reached[2]; // dist/prev/prevWeight are valid when this equals generation
+    vector<unsigned> settled[2];
+    vector<double> potential;    // A* potential, valid when potentialStamp equals generation
+    vector<unsigned> potentialStamp;
+    vector<pair<int, int> > heap[2];         // lazy min-heaps of (distance, station)
+    vector<pair<double, int> > keyedHeap[2]; // the same keyed by distance plus potential, for A*
+    vector<int> upward;                      // CH edges from the source up to the meeting station
+    vector<pair<int, int> > unpackStack;     // (edge, entry station) while unpacking shortcuts
+    RouteResult route;                       // for callers that only want the path
+    unsigned generation;
+
+    SearchWorkspace() : generation(0) {}
+
+    // Start a new search; stamps from earlier searches become stale
+    void begin(int stationCount) {
+        if (potential.size() != stationCount) {
+            for (int side = 0; side < 2; side++) {
+                dist[side].assign(stationCount, INT_MAX);
+                prev[side].assign(stationCount, -1);
+                prevWeight[side].assign(stationCount, 0);
+                reached[side].assign(stationCount, 0);
+                settled[side].assign(stationCount, 0);
+            }
+            potential.assign(stationCount, 0.0);
+            potentialStamp.assign(stationCount, 0);
+            generation = 0;
+        }
+        if (++generation == 0) {
+            for (int side = 0; side < 2; side++) {
+                fill(reached[side].begin(), reached[side].end(), 0);
+                fill(settled[side].begin(), settled[side].end(), 0);
+            }
+            fill(potentialStamp.begin(), potentialStamp.end(), 0);
+            generation = 1;
+        }
+        for (int side = 0; side < 2; side++) {
+            heap[side].clear();
+            keyedHeap[side].clear();
+        }
+    }
+
+    int distance(int side, int v) const {
+        return reached[side][v] == generation ? dist[side][v] : INT_MAX;
+    }
+
+    void reach(int side, int v, int d, int from, int weight) {
+        reached[side][v] = generation;
+        dist[side][v] = d;
+        prev[side][v] = from;
+        prevWeight[side][v] = weight;
+    }
+
+    bool isSettled(int side, int v) const { return settled[side][v] == generation; }
+};
+
+SearchWorkspace& searchWorkspace() {
+    thread_local SearchWorkspace workspace;
+    return workspace;
+}
+
+// Optimized Dijkstra with Priority Queue; stops as soon as the destination is settled
+void findRouteDijkstra(int source, int destination, const StationGraph& graph, RouteResult& result) {
+    SearchWorkspace& ws = searchWorkspace();
+    ws.begin(graph.stationCount);
+    vector<pair<int, int> >& heap = ws.heap[0];
+    greater<pair<int, int> > later;
+
+    result.clear();
+    ws.reach(0, source, 0, -1, 0);
+    heap.push_back(make_pair(0, source));
+    result.heapPushes++;
+
+    while (!heap.empty()) {
+        pop_heap(heap.begin(), heap.end(), later);
+        int u = heap.back().second;
+        heap.pop_back();
+
+        if (ws.isSettled(0, u)) continue;
+        ws.settled[0][u] = ws.generation;
+        result.settledNodes++;
+        if (u == destination) break;
+
+        int du = ws.dist[0][u];
+        int arcEnd = graph.offsets[u + 1];
+        result.relaxedEdges += arcEnd - graph.offsets[u];
+        for (int j = graph.offsets[u]; j < arcEnd; j++) {
+            int v = graph.neighbors[j];
+            int weight = graph.weights[j];
+
+            if (!ws.isSettled(0, v) && du + weight < ws.distance(0, v)) {
+                ws.reach(0, v, du + weight, u, weight);
+                heap.push_back(make_pair(du + weight, v));
+                push_heap(heap.begin(), heap.end(), later);
+                result.heapPushes++;
+            }
+        }
+    }
+
+    if (ws.distance(0, destination) == INT_MAX) return;
+
+    // Reconstruct path and legs from destination back to source
+    for (int at = destination; at != -1; at = ws.prev[0][at]) {
+        result.path.push_back(at);
+        if (at != source) result.legDistances.push_back(ws.prevWeight[0][at]);
+    }
+    reverse(result.path.begin(), result.path.end());
+    reverse(result.legDistances.begin(), result.legDistances.end());
+    finishRoute(result);
+}
+
+// 4-ary min-heap of stations keyed by distance, with decrease-key through a position
+// index. Shallower than a binary heap and each sift compares children in one cache line.
+struct StationHeap {
+    vector<pair<int, int> > items; // (distance, station)
+    vector<int> position;          // index of each station in items, -1 when not queued
+
+    void reset(int stationCount) {
+        items.clear();
+        position.assign(stationCount, -1);
+    }
+
+    bool empty() const { return items.empty(); }
+
+    void pushOrDecrease(int station, int key) {
+        int i = position[station];
+        if (i == -1) {
+            i = items.size();
+            items.push_back(make_pair(key, station));
+        } else {
+            items[i].first = key;
+        }
+        siftUp(i);
+    }
+
+    pair<int, int> pop() {
+        pair<int, int> top = items[0];
+        position[top.second] = -1;
+        pair<int, int> last = items.back();
+        items.pop_back();
+        if (!items.empty()) {
+            items[0] = last;
+            siftDown(0);
+        }
+        return top;
+    }
+
+    void siftUp(int i) {
+        pair<int, int> item = items[i];
+        while (i > 0) {
+            int parent = (i - 1) / 4;
+            if (items[parent].first <= item.first) break;
+            items[i] = items[parent];
+            position[items[i].second] = i;
+            i = parent;
+        }
+        items[i] = item;
+        position[item.second] = i;
+    }
+
+    void siftDown(int i) {
+        pair<int, int> item = items[i];
+        int n = items.size();
+        while (true) {
+            int first = 4 * i + 1;
+            if (first >= n) break;
+            int best = first;
+            int last = min(first + 4, n);
+            for (int c = first + 1; c < last; c++) {
+                if (items[c].first < items[best].first) best = c;
+            }
+            if (items[best].first >= item.first) break;
+            items[i] = items[best];
+            position[items[i].second] = i;
+            i = best;
+        }
+        items[i] = item;
+        position[item.second] = i;
+    }
+};
+
+// Shortest-path tree from one source, shared by every single-source consumer
+struct ShortestPathTree {
+    int source;
+    vector<int> dist;        // km from source, INT_MAX when unreachable
+    vector<int> prev;        // predecessor on the shortest route, -1 for source/unreachable
+    vector<int> settleOrder; // reachable stations in non-decreasing distance
+    long long relaxedEdges;  // arcs scanned, for the search metrics
+    long long heapPushes;    // pushes and decrease-keys
+    StationHeap heap;        // kept between calls so repeated trees reuse its storage
+};
+
+void computeShortestPathTree(const StationGraph& graph, int source, ShortestPathTree& tree) {
+    int n = graph.stationCount;
+    tree.source = source;
+    tree.dist.assign(n, INT_MAX);
+    tree.prev.assign(n, -1);
+    tree.settleOrder.clear();
+    tree.heap.reset(n);
+
+    long long relaxed = 0, pushes = 1;
+    tree.dist[source] = 0;
+    tree.heap.pushOrDecrease(source, 0);
+    while (!tree.heap.empty()) {
+        pair<int, int> top = tree.heap.pop();
+        int u = top.second, d = top.first;
+        tree.settleOrder.push_back(u);
+
+        int arcEnd = graph.offsets[u + 1];
+        relaxed += arcEnd - graph.offsets[u];
+        for (int j = graph.offsets[u]; j < arcEnd; j++) {
+            int v = graph.neighbors[j];
+            int candidate = d + graph.weights[j];
+            if (candidate < tree.dist[v]) {
+                tree.dist[v] = candidate;
+                tree.prev[v] = u;
+                tree.heap.pushOrDecrease(v, candidate);
+                pushes++;
+            }
+        }
+    }
+    tree.relaxedEdges = relaxed;
+    tree.heapPushes = pushes;
+}
+
+// Bidirectional A* with the average of the forward and backward great-circle
+// potentials, so both searches see the same consistent reduced arc costs.
+// Without coordinates the potentials are zero and this is bidirectional Dijkstra.
+void findRouteBidirectionalAStar(int source, int destination, const StationGraph& graph, RouteResult& result) {
+    result.clear();
+    if (source == destination) {
+        result.path.push_back(source);
+        finishRoute(result);
+        return;
+    }
+
+    SearchWorkspace& ws = searchWorkspace();
+    ws.begin(graph.stationCount);
+    unsigned generation = ws.generation;
+    greater<pair<double, int> > later;
+
+    double scale = graph.heuristicScale;
+    int terminal[2] = { source, destination };
+
+    // Forward potential, computed once per touched station; the backward search uses its negation
+    auto forwardPotential = [&](int v) -> double {
+        if (ws.potentialStamp[v] == generation) return ws.potential[v];
+        double value = 0.0;
+        if (scale > 0) {
+            double toDestination = greatCircleKm(graph.latitudeRad[v], graph.longitudeRad[v],
+                                                 graph.latitudeRad[destination], graph.longitudeRad[destination]);
+            double fromSource = greatCircleKm(graph.latitudeRad[v], graph.longitudeRad[v],
+                                              graph.latitudeRad[source], graph.longitudeRad[source]);
+            value = 0.5 * scale * (toDestination - fromSource);
+        }
+        ws.potential[v] = value;
+        ws.potentialStamp[v] = generation;
+        return value;
+    };
+
+    for (int side = 0; side < 2; side++) {
+        int t = terminal[side];
+        ws.reach(side, t, 0, -1, 0);
+        double p = forwardPotential(t);
+        ws.keyedHeap[side].push_back(make_pair(side == 0 ? p : -p, t));
+    }
+    result.heapPushes = 2;
+
+    int best = INT_MAX, meeting = -1;
+    while (!ws.keyedHeap[0].empty() && !ws.keyedHeap[1].empty()) {
+        // No undiscovered route can beat best once the two frontiers' keys add up to it;
+        // distances are whole km, so half a km of slack absorbs rounding in the potentials.
+        if (best != INT_MAX && ws.keyedHeap[0].front().first + ws.keyedHeap[1].front().first >= best - 0.5) break;
+
+        int side = ws.keyedHeap[0].size() <= ws.keyedHeap[1].size() ? 0 : 1;
+        int other = 1 - side;
+        vector<pair<double, int> >& heap = ws.keyedHeap[side];
+        pop_heap(heap.begin(), heap.end(), later);
+        int u = heap.back().second;
+        heap.pop_back();
+
+        if (ws.isSettled(side, u)) continue;
+        ws.settled[side][u] = generation;
+        result.settledNodes++;
+
+        int du = ws.dist[side][u];
+        int arcEnd = graph.offsets[u + 1];
+        result.relaxedEdges += arcEnd - graph.offsets[u];
+        for (int j = graph.offsets[u]; j < arcEnd; j++) {
+            int v = graph.neighbors[j];
+            int weight = graph.weights[j];
+            int candidate = du + weight;
+
+            if (!ws.isSettled(side, v) && candidate < ws.distance(side, v)) {
+                ws.reach(side, v, candidate, u, weight);
+                double p = forwardPotential(v);
+                heap.push_back(make_pair(candidate + (side == 0 ? p : -p), v));
+                push_heap(heap.begin(), heap.end(), later);
+                result.heapPushes++;
+            }
+            int otherDistance = ws.distance(other, v);
+            if (otherDistance != INT_MAX && ws.dist[side][v] + otherDistance < best) {
+                best = ws.dist[side][v] + otherDistance;
+                meeting = v;
+            }
+        }
+    }
+
+    if (meeting == -1) return;
+
+    // Forward half: source .. meeting, then backward half: meeting .. destination
+    for (int at = meeting; at != -1; at = ws.prev[0][at]) {
+        result.path.push_back(at);
+        if (at != source) result.legDistances.push_back(ws.prevWeight[0][at]);
+    }
+    reverse(result.path.begin(), result.path.end());
+    reverse(result.legDistances.begin(), result.legDistances.end());
+    for (int at = meeting; at != destination; at = ws.prev[1][at]) {
+        result.path.push_back(ws.prev[1][at]);
+        result.legDistances.push_back(ws.prevWeight[1][at]);
+    }
+    finishRoute(result);
+}
+
+// Contraction Hierarchies: stations are contracted one by one in order of
+// importance, adding shortcut edges that preserve shortest distances among the
+// stations still left. A query then only climbs to higher-ranked stations from
+// both ends, which touches a few hundred stations even on a national network.
+struct CHEdge {
+    int from;
+    int to;
+    int weight;
+    int firstChild;  // edge indices this shortcut replaces, -1 for an original track
+    int secondChild;
+};
+
+struct ContractionHierarchy {
+    int stationCount;
+    vector<int> rank;      // contraction order of each station
+    vector<CHEdge> edges;  // original tracks followed by shortcuts
+    vector<int> upOffsets; // CSR over edges leading to a higher-ranked station
+    vector<int> upEdges;
+    long long version;     // graphVersion the hierarchy was built or loaded for
+    unsigned long long fingerprint;
+
+    ContractionHierarchy() : stationCount(0), version(-1), fingerprint(0) {}
+};
+
+ContractionHierarchy contractionHierarchy;
+string contractionHierarchyFile = ""; // cache file for --ch-file, empty to always build
+
+// FNV-1a hash of the frozen graph, used to reject a stale hierarchy file
+unsigned long long graphFingerprint(const StationGraph& graph) {
+    unsigned long long hash = 1469598103934665603ULL;
+    const vector<int>* parts[3] = { &graph.offsets, &graph.neighbors, &graph.weights };
+    for (int p = 0; p < 3; p++) {
+        for (int i = 0; i < parts[p]->size(); i++) {
+            hash = (hash ^ (unsigned int)(*parts[p])[i]) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+// Bookkeeping shared by all node contractions of one build
+struct CHBuilder {
+    const StationGraph& graph;
+    ContractionHierarchy& ch;
+    vector<vector<int> > adjacent; // edge indices touching each station
+    vector<bool> contracted;
+    vector<int> deletedNeighbors;
+
+    // Witness search state, reset through the touched list
+    vector<int> witnessDist;
+    vector<int> touched;
+    vector<int> neighborWeight; // shortest edge from the station being contracted, per neighbor
+    vector<int> neighborEdge;
+
+    // Priority estimates use a cheaper witness search than the real contraction
+    static const int SIMULATE_SETTLE_LIMIT = 50;
+    static const int CONTRACT_SETTLE_LIMIT = 500;
+
+    CHBuilder(const StationGraph& g, ContractionHierarchy& h)
+        : graph(g), ch(h), adjacent(g.stationCount), contracted(g.stationCount, false),
+          deletedNeighbors(g.stationCount, 0), witnessDist(g.stationCount, INT_MAX),
+          neighborWeight(g.stationCount, INT_MAX), neighborEdge(g.stationCount, -1) {}
+
+    int otherEnd(int edge, int node) const {
+        return ch.edges[edge].from == node ? ch.edges[edge].to : ch.edges[edge].from;
+    }
+
+    void addEdge(int from, int to, int weight, int firstChild, int secondChild) {
+        CHEdge edge = { from, to, weight, firstChild, secondChild };
+        ch.edges.push_back(edge);
+        adjacent[from].push_back(ch.edges.size() - 1);
+        adjacent[to].push_back(ch.edges.size() - 1);
+    }
+
+    // Shortest remaining edge to every uncontracted neighbor of v (drops edges to contracted stations)
+    void collectNeighbors(int v, vector<int>& neighbors) {
+        neighbors.clear();
+        vector<int>& adj = adjacent[v];
+        int kept = 0;
+        for (int i = 0; i < adj.size(); i++) {
+            int w = otherEnd(adj[i], v);
+            if (contracted[w]) continue;
+            adj[kept++] = adj[i];
+            if (neighborEdge[w] == -1) neighbors.push_back(w);
+            if (ch.edges[adj[i]].weight < neighborWeight[w]) {
+                neighborWeight[w] = ch.edges[adj[i]].weight;
+                neighborEdge[w] = adj[i];
+            }
+        }
+        adj.resize(kept);
+    }
+
+    void clearNeighbors(const vector<int>& neighbors) {
+        for (int i = 0; i < neighbors.size(); i++) {
+            neighborWeight[neighbors[i]] = INT_MAX;
+            neighborEdge[neighbors[i]] = -1;
+        }
+    }
+
+    // Bounded Dijkstra from source over uncontracted stations, skipping via; stops early
+    // once all `targets` other neighbors of via (marked in neighborEdge) are settled
+    void witnessSearch(int source, int via, int maxDist, int targets, int settleLimit) {
+        for (int i = 0; i < touched.size(); i++) witnessDist[touched[i]] = INT_MAX;
+        touched.clear();
+
+        priority_queue<pair<int, int>, vector<pair<int, int> >, greater<pair<int, int> > > pq;
+        witnessDist[source] = 0;
+        touched.push_back(source);
+        pq.push(make_pair(0, source));
+        int settledCount = 0;
+
+        while (!pq.empty() && settledCount < settleLimit) {
+            int d = pq.top().first, u = pq.top().second;
+            pq.pop();
+            if (d > witnessDist[u]) continue;
+            if (d > maxDist) break;
+            settledCount++;
+            if (u != source && neighborEdge[u] != -1 && --targets == 0) break;
+
+            for (int i = 0; i < adjacent[u].size(); i++) {
+                int edge = adjacent[u][i];
+                int w = otherEnd(edge, u);
+                if (w == via || contracted[w]) continue;
+                int candidate = d + ch.edges[edge].weight;
+                if (candidate < witnessDist[w]) {
+                    if (witnessDist[w] == INT_MAX) touched.push_back(w);
+                    witnessDist[w] = candidate;
+                    pq.push(make_pair(candidate, w));
+                }
+            }
+        }
+    }
+
+    // Count (simulate) or add the shortcuts needed to remove v; returns the shortcut count
+    int contract(int v, bool simulate, int& degree) {
+        vector<int> neighbors;
+        collectNeighbors(v, neighbors);
+        degree = neighbors.size();
+
+        int maxWeight = 0;
+        for (int i = 0; i < neighbors.size(); i++) {
+            maxWeight = max(maxWeight, neighborWeight[neighbors[i]]);
+        }
+
+        int shortcuts = 0;
+        for (int i = 0; i < neighbors.size(); i++) {
+            int u = neighbors[i];
+            if (i + 1 == neighbors.size()) break;
+            witnessSearch(u, v, neighborWeight[u] + maxWeight, neighbors.size() - 1,
+                          simulate ? SIMULATE_SETTLE_LIMIT : CONTRACT_SETTLE_LIMIT);
+            for (int j = i + 1; j < neighbors.size(); j++) {
+                int w = neighbors[j];
+                int viaDist = neighborWeight[u] + neighborWeight[w];
+                if (witnessDist[w] <= viaDist) continue;
+                shortcuts++;
+                if (!simulate) {
+                    addEdge(u, w, viaDist, neighborEdge[u], neighborEdge[w]);
+                }
+            }
+        }
+
+        clearNeighbors(neighbors);
+        return shortcuts;
+    }
+
+    int priority(int v) {
+        int degree;
+        int shortcuts = contract(v, true, degree);
+        return 2 * (shortcuts - degree) + deletedNeighbors[v];
+    }
+
+    void build() {
+        int n = graph.stationCount;
+        ch.stationCount = n;
+        ch.edges.clear();
+        ch.rank.assign(n, 0);
+
+        // Original tracks, one edge per station pair
+        for (int u = 0; u < n; u++) {
+            for (int j = graph.offsets[u]; j < graph.offsets[u + 1]; j++) {
+                int v = graph.neighbors[j];
+                if (u < v) addEdge(u, v, graph.weights[j], -1, -1);
+            }
+        }
+
+        // Queue entries whose priority no longer matches currentPriority are stale and skipped
+        vector<int> currentPriority(n);
+        priority_queue<pair<int, int>, vector<pair<int, int> >, greater<pair<int, int> > > order;
+        for (int v = 0; v < n; v++) {
+            currentPriority[v] = priority(v);
+            order.push(make_pair(currentPriority[v], v));
+        }
+
+        int nextRank = 0;
+        while (!order.empty()) {
+            int v = order.top().second;
+            int queued = order.top().first;
+            order.pop();
+            if (contracted[v] || queued != currentPriority[v]) continue;
+
+            // Lazy update: re-evaluate and requeue if v is no longer the cheapest
+            currentPriority[v] = priority(v);
+            if (!order.empty() && currentPriority[v] > order.top().first) {
+                order.push(make_pair(currentPriority[v], v));
+                continue;
+            }
+
+            int degree;
+            contract(v, false, degree);
+            contracted[v] = true;
+            ch.rank[v] = nextRank++;
+
+            // Neighbors lost an edge and may have gained shortcuts; refresh their priorities
+            vector<int> neighbors;
+            collectNeighbors(v, neighbors);
+            clearNeighbors(neighbors);
+            for (int i = 0; i < neighbors.size(); i++) {
+                int w = neighbors[i];
+                deletedNeighbors[w]++;
+                currentPriority[w] = priority(w);
+                order.push(make_pair(currentPriority[w], w));
+            }
+        }
+    }
+};
+
+// Index the edges leading upwards in rank so queries can scan them contiguously
+void buildUpwardGraph(ContractionHierarchy& ch) {
+    int n = ch.stationCount;
+    ch.upOffsets.assign(n + 1, 0);
+    for (int e = 0; e < ch.edges.size(); e++) {
+        int lower = ch.rank[ch.edges[e].from] < ch.rank[ch.edges[e].to] ? ch.edges[e].from : ch.edges[e].to;
+        ch.upOffsets[lower + 1]++;
+    }
+    for (int v = 0; v < n; v++) ch.upOffsets[v + 1] += ch.upOffsets[v];
+    ch.upEdges.assign(ch.edges.size(), 0);
+    vector<int> fill(ch.upOffsets.begin(), ch.upOffsets.end() - 1);
+    for (int e = 0; e < ch.edges.size(); e++) {
+        int lower = ch.rank[ch.edges[e].from] < ch.rank[ch.edges[e].to] ? ch.edges[e].from : ch.edges[e].to;
+        ch.upEdges[fill[lower]++] = e;
+    }
+}
+
+void buildContractionHierarchy(const StationGraph& graph, ContractionHierarchy& ch) {
+    CHBuilder builder(graph, ch);
+    builder.build();
+    buildUpwardGraph(ch);
+    ch.fingerprint = graphFingerprint(graph);
+}
+
+const unsigned int CH_FILE_MAGIC = 0x48435752; // "RWCH"
+const unsigned int CH_FILE_VERSION = 1;
+
+bool saveContractionHierarchy(const ContractionHierarchy& ch, const string& path) {
+    ofstream out(path.c_str(), ios::binary);
+    if (!out) return false;
+    int edgeCount = ch.edges.size();
+    out.write((const char*)&CH_FILE_MAGIC, sizeof(CH_FILE_MAGIC));
+    out.write((const char*)&CH_FILE_VERSION, sizeof(CH_FILE_VERSION));
+    out.write((const char*)&ch.fingerprint, sizeof(ch.fingerprint));
+    out.write((const char*)&ch.stationCount, sizeof(ch.stationCount));
+    out.write((const char*)&edgeCount, sizeof(edgeCount));
+    out.write((const char*)ch.rank.data(), ch.rank.size() * sizeof(int));
+    out.write((const char*)ch.edges.data(), ch.edges.size() * sizeof(CHEdge));
+    return (bool)out;
+}
+
+// Load a hierarchy written by saveContractionHierarchy; fails if it was built for another
+// graph or does not hold together, and then leaves ch as it was so the caller can rebuild
+bool loadContractionHierarchy(ContractionHierarchy& ch, const string& path, const StationGraph& graph) {
+    ifstream in(path.c_str(), ios::binary | ios::ate);
+    if (!in) return false;
+    streamoff fileSize = in.tellg();
+    in.seekg(0);
+    unsigned int magic = 0, version = 0;
+    unsigned long long fingerprint = 0;
+    int stationCount = 0, edgeCount = 0;
+    in.read((char*)&magic, sizeof(magic));
+    in.read((char*)&version, sizeof(version));
+    in.read((char*)&fingerprint, sizeof(fingerprint));
+    in.read((char*)&stationCount, sizeof(stationCount));
+    in.read((char*)&edgeCount, sizeof(edgeCount));
+    streamoff headerBytes = in.tellg();
+    if (!in || magic != CH_FILE_MAGIC || version != CH_FILE_VERSION ||
+        stationCount != graph.stationCount || edgeCount < 0 || fingerprint != graphFingerprint(graph) ||
+        fileSize != headerBytes + (streamoff)stationCount * sizeof(int) + (streamoff)edgeCount * sizeof(CHEdge)) {
+        return false;
+    }
+
+    vector<int> rank(stationCount);
+    vector<CHEdge> edges(edgeCount);
+    in.read((char*)rank.data(), stationCount * sizeof(int));
+    in.read((char*)edges.data(), edgeCount * sizeof(CHEdge));
+    if (!in) return false;
+
+    // Ranks are a permutation of the stations
+    vector<bool> rankTaken(stationCount, false);
+    for (int v = 0; v < stationCount; v++) {
+        if (rank[v] < 0 || rank[v] >= stationCount || rankTaken[rank[v]]) return false;
+        rankTaken[rank[v]] = true;
+    }
+    // Each shortcut replaces two earlier edges that meet at one station and span its ends,
+    // so unpacking always terminates and yields a connected path of the right length
+    for (int e = 0; e < edgeCount; e++) {
+        const CHEdge& edge = edges[e];
+        if (edge.from < 0 || edge.from >= stationCount || edge.to < 0 || edge.to >= stationCount) return false;
+        if (edge.firstChild == -1 && edge.secondChild == -1) continue;
+        if (edge.firstChild < 0 || edge.firstChild >= e || edge.secondChild < 0 || edge.secondChild >= e) {
+            return false;
+        }
+        const CHEdge& first = edges[edge.firstChild];
+        const CHEdge& second = edges[edge.secondChild];
+        int middle = first.from == second.from || first.from == second.to ? first.from : first.to;
+        int firstEnd = first.from == middle ? first.to : first.from;
+        int secondEnd = second.from == middle ? second.to : second.from;
+        if ((second.from != middle && second.to != middle) ||
+            !((firstEnd == edge.from && secondEnd == edge.to) || (firstEnd == edge.to && secondEnd == edge.from)) ||
+            (long long)first.weight + second.weight != edge.weight) {
+            return false;
+        }
+    }
+
+    ch.stationCount = stationCount;
+    ch.fingerprint = fingerprint;
+    ch.rank.swap(rank);
+    ch.edges.swap(edges);
+    buildUpwardGraph(ch);
+    return true;
+}
+
+// Build the hierarchy for the global network, or load it from contractionHierarchyFile
+const ContractionHierarchy& getContractionHierarchy() {
+    if (contractionHierarchy.version == graphVersion) return contractionHierarchy;
+
+    const StationGraph& graph = getStationGraph();
+    if (contractionHierarchyFile == "" ||
+        !loadContractionHierarchy(contractionHierarchy, contractionHierarchyFile, graph)) {
+        buildContractionHierarchy(graph, contractionHierarchy);
+        if (contractionHierarchyFile != "" &&
+            !saveContractionHierarchy(contractionHierarchy, contractionHierarchyFile)) {
+            cerr << "Could not write contraction hierarchy to " << contractionHierarchyFile << "\n";
+        }
+    }
+    contractionHierarchy.version = graphVersion;
+    return contractionHierarchy;
+}
+
+// Expand a (possibly shortcut) edge entered at station `from` into original legs
+void unpackCHEdge(const ContractionHierarchy& ch, int edge, int from, RouteResult& result,
+                  vector<pair<int, int> >& stack) {
+    stack.clear(); // (edge, entry station)
+    stack.push_back(make_pair(edge, from));
+    while (!stack.empty()) {
+        int e = stack.back().first, at = stack.back().second;
+        stack.pop_back();
+        const CHEdge& current = ch.edges[e];
+        int exit = current.from == at ? current.to : current.from;
+        if (current.firstChild == -1) {
+            result.path.push_back(exit);
+            result.legDistances.push_back(current.weight);
+            continue;
+        }
+        // The child touching `at` comes first; push it last so it is expanded first
+        const CHEdge& first = ch.edges[current.firstChild];
+        bool firstTouchesEntry = first.from == at || first.to == at;
+        int entryChild = firstTouchesEntry ? current.firstChild : current.secondChild;
+        int exitChild = firstTouchesEntry ? current.secondChild : current.firstChild;
+        int middle = ch.edges[entryChild].from == at ? ch.edges[entryChild].to : ch.edges[entryChild].from;
+        stack.push_back(make_pair(exitChild, middle));
+        stack.push_back(make_pair(entryChild, at));
+    }
+}
+
+// Bidirectional upward search; both sides only relax edges towards higher-ranked stations
+void findRouteContractionHierarchy(int source, int destination, const ContractionHierarchy& ch,
+                                   RouteResult& result) {
+    SearchWorkspace& ws = searchWorkspace();
+    ws.begin(ch.stationCount);
+    unsigned generation = ws.generation;
+    greater<pair<int, int> > later;
+    result.clear();
+
+    int terminal[2] = { source, destination };
+    for (int side = 0; side < 2; side++) {
+        ws.reach(side, terminal[side], 0, -1, 0);
+        ws.heap[side].push_back(make_pair(0, terminal[side]));
+    }
+    result.heapPushes = 2;
+
+    int best = INT_MAX, meeting = -1;
+    int side = 0;
+    while (!ws.heap[0].empty() || !ws.heap[1].empty()) {
+        // A side is finished once its smallest key cannot improve the best meeting distance
+        for (int s = 0; s < 2; s++) {
+            if (!ws.heap[s].empty() && ws.heap[s].front().first >= best) ws.heap[s].clear();
+        }
+        if (ws.heap[side].empty()) side = 1 - side;
+        if (ws.heap[side].empty()) break;
+
+        vector<pair<int, int> >& heap = ws.heap[side];
+        pop_heap(heap.begin(), heap.end(), later);
+        int u = heap.back().second;
+        heap.pop_back();
+        if (!ws.isSettled(side, u)) {
+            ws.settled[side][u] = generation;
+            result.settledNodes++;
+            int otherDistance = ws.distance(1 - side, u);
+            if (otherDistance != INT_MAX && ws.dist[side][u] + otherDistance < best) {
+                best = ws.dist[side][u] + otherDistance;
+                meeting = u;
+            }
+
+            // Stall-on-demand: a higher-ranked neighbor already reaches u more cheaply,
+            // so u lies on no shortest up-path and need not be expanded
+            bool stalled = false;
+            for (int i = ch.upOffsets[u]; i < ch.upOffsets[u + 1] && !stalled; i++) {
+                int e = ch.upEdges[i];
+                int v = ch.edges[e].from == u ? ch.edges[e].to : ch.edges[e].from;
+                int dv = ws.distance(side, v);
+                if (dv != INT_MAX && dv + ch.edges[e].weight < ws.dist[side][u]) stalled = true;
+            }
+
+            if (!stalled) result.relaxedEdges += ch.upOffsets[u + 1] - ch.upOffsets[u];
+            for (int i = ch.upOffsets[u]; i < ch.upOffsets[u + 1] && !stalled; i++) {
+                int e = ch.upEdges[i];
+                int v = ch.edges[e].from == u ? ch.edges[e].to : ch.edges[e].from;
+                int candidate = ws.dist[side][u] + ch.edges[e].weight;
+                if (candidate < ws.distance(side, v)) {
+                    ws.reach(side, v, candidate, e, 0);
+                    heap.push_back(make_pair(candidate, v));
+                    push_heap(heap.begin(), heap.end(), later);
+                    result.heapPushes++;
+                }
+            }
+        }
+        side = 1 - side;
+    }
+
+    if (meeting == -1) return;
+
+    // Upward edges from source to the meeting station, in travel order
+    vector<int>& upward = ws.upward;
+    upward.clear();
+    for (int at = meeting; at != source; ) {
+        int e = ws.prev[0][at];
+        upward.push_back(e);
+        at = ch.edges[e].from == at ? ch.edges[e].to : ch.edges[e].from;
+    }
+    result.path.push_back(source);
+    int at = source;
+    for (int i = upward.size() - 1; i >= 0; i--) {
+        unpackCHEdge(ch, upward[i], at, result, ws.unpackStack);
+        at = result.path.back();
+    }
+    // Downward edges from the meeting station to destination
+    while (at != destination) {
+        int e = ws.prev[1][at];
+        unpackCHEdge(ch, e, at, result, ws.unpackStack);
+        at = result.path.back();
+    }
+    finishRoute(result);
+}
+
+// All-pairs distance table so route, fare and time quotes become a lookup.
+// Rows are filled by one heap-based Dijkstra per source, spread over worker threads.
+const uint32_t UNREACHABLE_DISTANCE = 0xFFFFFFFFu;
+const uint16_t NO_NEXT_HOP = 0xFFFF;
+const int MAX_MATRIX_STATIONS = 4096; // 4096^2 * 6 bytes = 96 MB
+
+struct DistanceMatrix {
+    int stationCount;
+    vector<uint32_t> distance; // row-major: distance[from * stationCount + to]
+    vector<uint16_t> nextHop;  // first station after `from` on a shortest route to `to`
+    long long version;         // graphVersion the matrix was built for
+
+    DistanceMatrix() : stationCount(0), version(-1) {}
+};
+
+DistanceMatrix distanceMatrix;
+bool useDistanceMatrix = false; // --precompute-matrix
+
+// Write one matrix row from the source's shortest-path tree; the tree is reused by each worker
+void fillDistanceMatrixRow(const StationGraph& graph, int source, uint32_t* distanceRow, uint16_t* hopRow,
+                           ShortestPathTree& tree) {
+    int n = graph.stationCount;
+    computeShortestPathTree(graph, source, tree);
+
+    for (int v = 0; v < n; v++) {
+        distanceRow[v] = UNREACHABLE_DISTANCE;
+        hopRow[v] = NO_NEXT_HOP;
+    }
+    // Predecessors settle first, so each station inherits its predecessor's first hop
+    for (int i = 0; i < tree.settleOrder.size(); i++) {
+        int v = tree.settleOrder[i];
+        int u = tree.prev[v];
+        distanceRow[v] = tree.dist[v];
+        hopRow[v] = u == -1 ? v : (u == source ? v : hopRow[u]);
+    }
+}
+
+void buildDistanceMatrix(const StationGraph& graph, DistanceMatrix& matrix) {
+    int n = graph.stationCount;
+    matrix.stationCount = n;
+    matrix.distance.assign((size_t)n * n, UNREACHABLE_DISTANCE);
+    matrix.nextHop.assign((size_t)n * n, NO_NEXT_HOP);
+
+    // Workers pull source stations from a shared counter until every row is done
+    atomic<int> nextSource(0);
+    int workerCount = max(1, min(n, (int)thread::hardware_concurrency()));
+    vector<thread> workers;
+    for (int w = 0; w < workerCount; w++) {
+        workers.push_back(thread([&graph, &matrix, &nextSource, n]() {
+            ShortestPathTree tree;
+            for (int source = nextSource++; source < n; source = nextSource++) {
+                fillDistanceMatrixRow(graph, source, &matrix.distance[(size_t)source * n],
+                                      &matrix.nextHop[(size_t)source * n], tree);
+            }
+        }));
+    }
+    for (int w = 0; w < workerCount; w++) workers[w].join();
+}
+
+// Matrix for the global network, rebuilt after any addStation/addConnection.
+// Returns null when the matrix is disabled or the network is too large for it.
+const DistanceMatrix* getDistanceMatrix() {
+    if (!useDistanceMatrix || stations.size() > MAX_MATRIX_STATIONS) return NULL;
+    if (distanceMatrix.version != graphVersion) {
+        buildDistanceMatrix(getStationGraph(), distanceMatrix);
+        distanceMatrix.version = graphVersion;
+    }
+    return &distanceMatrix;
+}
+
+// Walk the next-hop table; each leg is the drop in remaining distance
+void findRouteFromMatrix(int source, int destination, const DistanceMatrix& matrix, RouteResult& result) {
+    result.clear();
+    size_t n = matrix.stationCount;
+    if (matrix.distance[source * n + destination] == UNREACHABLE_DISTANCE) return;
+
+    result.path.push_back(source);
+    for (int at = source; at != destination; ) {
+        int next = matrix.nextHop[at * n + destination];
+        result.legDistances.push_back(matrix.distance[at * n + destination] - matrix.distance[next * n + destination]);
+        result.path.push_back(next);
+        at = next;
+    }
+    finishRoute(result);
+}
+
+// Bounded LRU cache of point-to-point routes on the global network. Entries are
+// spread over independently locked shards so concurrent request handlers rarely
+// contend; a shard drops its entries once graphVersion moves past the one they were computed for.
+struct RouteCacheShard {
+    mutex lock;
+    list<pair<long long, RouteResult> > entries; // most recently used first
+    unordered_map<long long, list<pair<long long, RouteResult> >::iterator> index;
+    long long version;
+
+    RouteCacheShard() : version(-1) {}
+};
+
+struct RouteCache {
+    static const int SHARD_COUNT = 16;
+    RouteCacheShard shards[SHARD_COUNT];
+    int capacityPerShard;
+    atomic<long long> hits;
+    atomic<long long> misses;
+    atomic<long long> evictions;
+
+    RouteCache() : capacityPerShard(64), hits(0), misses(0), evictions(0) {}
+
+    static long long key(int source, int destination) {
+        return ((long long)source << 32) | (unsigned int)destination;
+    }
+
+    RouteCacheShard& shardFor(long long k) {
+        return shards[(unsigned long long)(k * 0x9E3779B97F4A7C15ULL) >> 60];
+    }
+
+    // Drop everything cached for an older network (caller holds the shard lock)
+    void refresh(RouteCacheShard& shard, long long version) {
+        if (shard.version == version) return;
+        shard.entries.clear();
+        shard.index.clear();
+        shard.version = version;
+    }
+
+    bool lookup(int source, int destination, long long version, RouteResult& result) {
+        if (capacityPerShard == 0) return false;
+        long long k = key(source, destination);
+        RouteCacheShard& shard = shardFor(k);
+        lock_guard<mutex> guard(shard.lock);
+        refresh(shard, version);
+        unordered_map<long long, list<pair<long long, RouteResult> >::iterator>::iterator it = shard.index.find(k);
+        if (it == shard.index.end()) {
+            misses++;
+            return false;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        result = it->second->second;
+        hits++;
+        return true;
+    }
+
+    void store(int source, int destination, long long version, const RouteResult& result) {
+        if (capacityPerShard == 0) return;
+        long long k = key(source, destination);
+        RouteCacheShard& shard = shardFor(k);
+        lock_guard<mutex> guard(shard.lock);
+        refresh(shard, version);
+        if (shard.version != version || shard.index.count(k)) return;
+        shard.entries.push_front(make_pair(k, result));
+        shard.index[k] = shard.entries.begin();
+        if ((int)shard.entries.size() > capacityPerShard) {
+            shard.index.erase(shard.entries.back().first);
+            shard.entries.pop_back();
+            evictions++;
+        }
+    }
+
+    // Keep the cached routes that avoid segment a - b and move them to version `to`; the
+    // rest of each shard, and any shard not on version `from`, is dropped
+    void retainRoutesAvoiding(int a, int b, long long from, long long to) {
+        for (int s = 0; s < SHARD_COUNT; s++) {
+            RouteCacheShard& shard = shards[s];
+            lock_guard<mutex> guard(shard.lock);
+            if (shard.version != from) {
+                refresh(shard, to);
+                continue;
+            }
+            list<pair<long long, RouteResult> >::iterator it = shard.entries.begin();
+            while (it != shard.entries.end()) {
+                const vector<int>& path = it->second.path;
+                bool crosses = false;
+                for (int i = 0; i + 1 < path.size() && !crosses; i++) {
+                    crosses = (path[i] == a && path[i + 1] == b) || (path[i] == b && path[i + 1] == a);
+                }
+                if (crosses) {
+                    shard.index.erase(it->first);
+                    it = shard.entries.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            shard.version = to;
+        }
+    }
+
+    size_t size() {
+        size_t total = 0;
+        for (int i = 0; i < SHARD_COUNT; i++) {
+            lock_guard<mutex> guard(shards[i].lock);
+            total += shards[i].entries.size();
+        }
+        return total;
+    }
+};
+
+RouteCache routeCache;
+bool printRouteCacheStats = false; // --cache-stats
+
+// --route-cache=N; 0 disables the cache
+void setRouteCacheCapacity(int entries) {
+    routeCache.capacityPerShard = entries <= 0 ? 0 : max(1, entries / RouteCache::SHARD_COUNT);
+}
+
+void displayRouteCacheStats() {
+    long long hits = routeCache.hits, misses = routeCache.misses;
+    cerr << "Route cache: " << hits << " hits, " << misses << " misses ("
+         << fixed << setprecision(1) << (hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0)
+         << "% hit rate), " << routeCache.evictions << " evictions, " << routeCache.size() << "/"
+         << routeCache.capacityPerShard * RouteCache::SHARD_COUNT << " entries\n";
+}
+
+// Point-to-point search on the configured engine
+void searchRoute(int source, int destination, const StationGraph& graph, RouteResult& result) {
+    if (routeEngine == ENGINE_DIJKSTRA) {
+        findRouteDijkstra(source, destination, graph, result);
+        recordSearch(SEARCH_DIJKSTRA, result.settledNodes, result.relaxedEdges, result.heapPushes);
+        return;
+    }
+
+    const char* engineName;
+    if (routeEngine == ENGINE_CONTRACTION_HIERARCHY && &graph == &stationGraph) {
+        findRouteContractionHierarchy(source, destination, getContractionHierarchy(), result);
+        recordSearch(SEARCH_CH, result.settledNodes, result.relaxedEdges, result.heapPushes);
+        engineName = "CH";
+    } else {
+        findRouteBidirectionalAStar(source, destination, graph, result);
+        recordSearch(SEARCH_ASTAR, result.settledNodes, result.relaxedEdges, result.heapPushes);
+        engineName = "A*";
+    }
+    if (verifyRouteEngine) {
+        RouteResult reference;
+        findRouteDijkstra(source, destination, graph, reference);
+        if (reference.totalDistance != result.totalDistance) {
+            cerr << "Route engine mismatch " << source << " -> " << destination << ": " << engineName << " "
+                 << result.totalDistance << " km, Dijkstra " << reference.totalDistance << " km\n";
+        }
+    }
+}
+
+// Build the hierarchy and matrix that findRoute would otherwise build on first use. Those
+// lazy builds are not locked, so this must run before route queries come from several threads.
+void prepareRouteQueries() {
+    freezeStationGraph();
+    if (routeEngine == ENGINE_CONTRACTION_HIERARCHY) getContractionHierarchy();
+    getDistanceMatrix();
+}
+
+// Route query: the all-pairs matrix when enabled, then the route cache, then a search.
+// result's storage is reused, so a caller that keeps it allocates nothing on a steady stream of queries.
+void findRoute(int source, int destination, const StationGraph& graph, RouteResult& result) {
+    OperationTimer timer(METRIC_ROUTE);
+    if (&graph != &stationGraph) {
+        searchRoute(source, destination, graph, result);
+        timer.stop();
+        return;
+    }
+
+    const DistanceMatrix* matrix = getDistanceMatrix();
+    if (matrix != NULL) {
+        findRouteFromMatrix(source, destination, *matrix, result);
+        timer.stop();
+        return;
+    }
+
+    long long version = graphVersion;
+    if (!routeCache.lookup(source, destination, version, result)) {
+        searchRoute(source, destination, graph, result);
+        routeCache.store(source, destination, version, result);
+    }
+    timer.stop();
+}
+
+RouteResult findRoute(int source, int destination, const StationGraph& graph) {
+    RouteResult result;
+    findRoute(source, destination, graph, result);
+    return result;
+}
+
+RouteResult findRoute(int source, int destination) {
+    return findRoute(source, destination, getStationGraph());
+}
+
+// Shortest path into path (empty when the destination is unreachable), reusing its storage
+void dijkstra(int source, int destination, const StationGraph& graph, vector<int>& path) {
+    RouteResult& route = searchWorkspace().route;
+    findRoute(source, destination, graph, route);
+    path.assign(route.path.begin(), route.path.end());
+}
+
+// Shortest path only; empty when the destination is unreachable
+vector<int> dijkstra(int source, int destination, const StationGraph& graph) {
+    vector<int> path;
+    dijkstra(source, destination, graph, path);
+    return path;
+}
+
+vector<int> dijkstra(int source, int destination, const vector<Station>& stations) {
+    if (&stations == &::stations) {
+        return dijkstra(source, destination, getStationGraph());
+    }
+    StationGraph graph;
+    freezeGraph(stations, graph);
+    return dijkstra(source, destination, graph);
+}
+
+// Track Closures
+//
+// Engineering works take segments out of service and put them back, and segments get
+// re-measured. A change edits the adjacency lists, refreezes the CSR arrays (a linear
+// copy) and then repairs the route data for the new network instead of discarding it:
+//   - a shorter or reopened segment can only shorten routes, and every new shortest
+//     route crosses it once, so each matrix row is patched by one pass over its stations
+//   - a longer or closed segment only changes the routes that ran over it; in each row
+//     those stations are re-settled by a Dijkstra confined to them, seeded from their
+//     unaffected neighbours
+//   - cached routes that avoid a lengthened or closed segment stay shortest and are kept
+// The contraction hierarchy is rebuilt the next time it is used.
+
+// Length of each closed segment, so reopening restores it
+unordered_map<uint64_t, int> closedSegments;
+
+// Length of the connection between a and b in km, or -1 if they are not adjacent
+int getConnectionDistance(int a, int b) {
+    int km = -1;
+    for (int j = 0; j < stations[a].connections.size(); j++) {
+        if (stations[a].connections[j].first == b && (km == -1 || stations[a].connections[j].second < km)) {
+            km = stations[a].connections[j].second;
+        }
+    }
+    return km;
+}
+
+// Remove every arc between a and b; returns the shortest one's km, or -1 if they were not adjacent
+int removeConnectionArcs(int a, int b) {
+    int removed = -1;
+    for (int side = 0; side < 2; side++) {
+        int from = side == 0 ? a : b, to = side == 0 ? b : a;
+        vector<pair<int, int> >& connections = stations[from].connections;
+        for (int j = connections.size() - 1; j >= 0; j--) {
+            if (connections[j].first != to) continue;
+            if (removed == -1 || connections[j].second < removed) removed = connections[j].second;
+            connections.erase(connections.begin() + j);
+        }
+    }
+    return removed;
+}
+
+// Stations whose shortest routes from source run a -> b get their distances recomputed;
+// the other stations' routes avoid the segment and stay as they are. aRow and bRow are
+// the rows of a and b from before the change.
+void repairMatrixRowAfterIncrease(const StationGraph& graph, DistanceMatrix& matrix, int source, int a, int b,
+                                  int oldKm, const vector<uint32_t>& aRow, const vector<uint32_t>& bRow,
+                                  vector<char>& affected, vector<int>& members, StationHeap& heap) {
+    size_t n = matrix.stationCount;
+    uint32_t* distanceRow = &matrix.distance[source * n];
+    uint16_t* hopRow = &matrix.nextHop[source * n];
+    if (distanceRow[a] == UNREACHABLE_DISTANCE) return;
+
+    // Orient the segment the way routes from source cross it, if they do at all
+    bool forward = distanceRow[b] == distanceRow[a] + oldKm;
+    bool backward = distanceRow[a] == distanceRow[b] + oldKm;
+    if (!forward && !backward) return;
+    const vector<uint32_t>* farRow = &bRow;
+    if (backward) {
+        swap(a, b);
+        farRow = &aRow;
+    }
+
+    // Stations with a shortest route through a -> b lose their distance and hop
+    uint32_t throughB = distanceRow[b];
+    members.clear();
+    for (size_t v = 0; v < n; v++) {
+        uint32_t rest = (*farRow)[v];
+        if (rest != UNREACHABLE_DISTANCE && distanceRow[v] == throughB + rest) {
+            affected[v] = 1;
+            members.push_back(v);
+        }
+    }
+
+    // Seed each from its best neighbour outside the set, then settle the set among itself
+    heap.reset(n);
+    for (int i = 0; i < members.size(); i++) {
+        int v = members[i];
+        distanceRow[v] = UNREACHABLE_DISTANCE;
+        hopRow[v] = NO_NEXT_HOP;
+        for (int j = graph.offsets[v]; j < graph.offsets[v + 1]; j++) {
+            int u = graph.neighbors[j];
+            if (affected[u] || distanceRow[u] == UNREACHABLE_DISTANCE) continue;
+            uint32_t candidate = distanceRow[u] + graph.weights[j];
+            if (candidate < distanceRow[v]) {
+                distanceRow[v] = candidate;
+                hopRow[v] = u == source ? v : hopRow[u];
+            }
+        }
+        if (distanceRow[v] != UNREACHABLE_DISTANCE) heap.pushOrDecrease(v, distanceRow[v]);
+    }
+    while (!heap.empty()) {
+        int u = heap.pop().second;
+        affected[u] = 0;
+        for (int j = graph.offsets[u]; j < graph.offsets[u + 1]; j++) {
+            int v = graph.neighbors[j];
+            if (!affected[v]) continue;
+            uint32_t candidate = distanceRow[u] + graph.weights[j];
+            if (candidate < distanceRow[v]) {
+                distanceRow[v] = candidate;
+                hopRow[v] = hopRow[u];
+                heap.pushOrDecrease(v, candidate);
+            }
+        }
+    }
+    for (int i = 0; i < members.size(); i++) affected[members[i]] = 0; // cut off by the closure
+}
+
+// Relax every route from source over a segment a - b that is now newKm long. The entries
+// for a and b go first, since the other stations' new first hops are read from them.
+void repairMatrixRowAfterDecrease(DistanceMatrix& matrix, int source, int a, int b, int newKm,
+                                  const vector<uint32_t>& aRow, const vector<uint32_t>& bRow) {
+    size_t n = matrix.stationCount;
+    uint32_t* distanceRow = &matrix.distance[source * n];
+    uint16_t* hopRow = &matrix.nextHop[source * n];
+    uint32_t toA = distanceRow[a], toB = distanceRow[b];
+    if (toA == UNREACHABLE_DISTANCE && toB == UNREACHABLE_DISTANCE) return;
+
+    if (toA != UNREACHABLE_DISTANCE && toA + newKm < toB) {
+        distanceRow[b] = toA + newKm;
+        hopRow[b] = source == a ? b : hopRow[a];
+    } else if (toB != UNREACHABLE_DISTANCE && toB + newKm < toA) {
+        distanceRow[a] = toB + newKm;
+        hopRow[a] = source == b ? a : hopRow[b];
+    }
+    for (size_t v = 0; v < n; v++) {
+        if (v == a || v == b) continue;
+        uint32_t viaA = toA == UNREACHABLE_DISTANCE || bRow[v] == UNREACHABLE_DISTANCE
+                            ? UNREACHABLE_DISTANCE : toA + newKm + bRow[v];
+        uint32_t viaB = toB == UNREACHABLE_DISTANCE || aRow[v] == UNREACHABLE_DISTANCE
+                            ? UNREACHABLE_DISTANCE : toB + newKm + aRow[v];
+        if (viaA <= viaB && viaA < distanceRow[v]) {
+            distanceRow[v] = viaA;
+            hopRow[v] = source == a ? b : hopRow[a];
+        } else if (viaB < viaA && viaB < distanceRow[v]) {
+            distanceRow[v] = viaB;
+            hopRow[v] = source == b ? a : hopRow[b];
+        }
+    }
+}
+
+// Bring the matrix from the network before a change of segment a - b to the network in
+// graph. oldKm or newKm is -1 when the segment did not exist before or does not after.
+void repairDistanceMatrix(const StationGraph& graph, DistanceMatrix& matrix, int a, int b, int oldKm, int newKm) {
+    int n = matrix.stationCount;
+    // Rows are repaired in parallel, so the rows of a and b are read from copies
+    vector<uint32_t> aRow(matrix.distance.begin() + (size_t)a * n, matrix.distance.begin() + (size_t)(a + 1) * n);
+    vector<uint32_t> bRow(matrix.distance.begin() + (size_t)b * n, matrix.distance.begin() + (size_t)(b + 1) * n);
+    bool longer = oldKm != -1 && (newKm == -1 || newKm > oldKm);
+    bool shorter = newKm != -1 && (oldKm == -1 || newKm < oldKm);
+    if (!longer && !shorter) return;
+
+    atomic<int> nextSource(0);
+    int workerCount = max(1, min(n, (int)thread::hardware_concurrency()));
+    vector<thread> workers;
+    for (int w = 0; w < workerCount; w++) {
+        workers.push_back(thread([&, n]() {
+            vector<char> affected(longer ? n : 0, 0);
+            vector<int> members;
+            StationHeap heap;
+            for (int source = nextSource++; source < n; source = nextSource++) {
+                if (longer) {
+                    repairMatrixRowAfterIncrease(graph, matrix, source, a, b, oldKm, aRow, bRow, affected, members, heap);
+                } else {
+                    repairMatrixRowAfterDecrease(matrix, source, a, b, newKm, aRow, bRow);
+                }
+            }
+        }));
+    }
+    for (int w = 0; w < workerCount; w++) workers[w].join();
+}
+
+// Replace the connection between a and b by one of newKm (-1 for none) and repair the
+// frozen graph, the distance matrix and the route cache for it
+void changeConnection(int a, int b, int newKm) {
+    long long before = graphVersion;
+    bool matrixCurrent = distanceMatrix.version == before && stationGraph.version == before;
+    int oldKm = removeConnectionArcs(a, b);
+    if (newKm != -1) {
+        registerSegment(a, b);
+        stations[a].connections.push_back(make_pair(b, newKm));
+        stations[b].connections.push_back(make_pair(a, newKm));
+    }
+    graphVersion++;
+    freezeStationGraph();
+
+    if (matrixCurrent) {
+        repairDistanceMatrix(stationGraph, distanceMatrix, a, b, oldKm, newKm);
+        distanceMatrix.version = graphVersion;
+    }
+    if (oldKm != -1 && (newKm == -1 || newKm >= oldKm)) {
+        routeCache.retainRoutesAvoiding(a, b, before, graphVersion);
+    }
+}
+
+// Take the segment between a and b out of service; false if they are not adjacent
+bool closeConnection(int a, int b) {
+    int km = getConnectionDistance(a, b);
+    if (km == -1) return false;
+    changeConnection(a, b, -1);
+    closedSegments[segmentKey(a, b)] = km;
+    return true;
+}
+
+// Put a closed segment back at its previous length; false if it is not closed
+bool reopenConnection(int a, int b) {
+    unordered_map<uint64_t, int>::iterator it = closedSegments.find(segmentKey(a, b));
+    if (it == closedSegments.end()) return false;
+    int km = it->second;
+    closedSegments.erase(it);
+    changeConnection(a, b, km);
+    return true;
+}
+
+// Set the length of an open segment; false if a and b are not adjacent
+bool setConnectionDistance(int a, int b, int km) {
+    if (km <= 0 || getConnectionDistance(a, b) == -1) return false;
+    changeConnection(a, b, km);
+    return true;
+}
+
+// Timetable
+//
+// Scheduled trains as a flat array of elementary connections (one train running
+// between two consecutive stops). Times are minutes after midnight of the day the
+// train set out, so they pass 24:00 on overnight runs. Earliest-arrival queries use
+// the Connection Scan Algorithm: one pass over the connections in departure order,
+// starting at the requested time. Trains that set out the day before may still be
+// running on the query day and the next day's trains may be needed too, so the scan
+// array holds every connection once per service day that reaches the query window,
+// already shifted onto the query day's clock and sorted.
+
+const int MINUTES_PER_DAY = 24 * 60;
+const int MIN_TRANSFER_MINUTES = 10; // to change trains anywhere but the starting station
+
+struct TimetableConnection {
+    int departure;
+    int arrival;
+    int from;
+    int to;
+    int trip; // index into Timetable::tripTrain; in the scan array, run = trip + day index * trip count
+};
+
+struct Timetable {
+    vector<TimetableConnection> connections; // as scheduled, grouped by trip
+    vector<int> tripTrain;                   // train number of each trip (one daily run of a train)
+    vector<int> tripStopStart;               // stops of trip t are tripStops[tripStopStart[t]] .. [t + 1] - 1
+    vector<int> tripStops;
+    int firstDay;                            // earliest service day, relative to the query day, still running
+    vector<TimetableConnection> scan;        // query-day clock, sorted by departure; trip holds the run
+
+    Timetable() : firstDay(0) {}
+
+    bool empty() const { return connections.empty(); }
+};
+
+// One ride on one train within a journey; times are minutes after midnight of the query day
+struct TimetableRide {
+    int trip;
+    int train;
+    int fromStation;
+    int toStation;
+    int departure;
+    int arrival;
+    int serviceDay; // days after the query day that this train set out
+};
+
+struct TimetableJourney {
+    bool found;
+    int departure;
+    int arrival;
+    vector<TimetableRide> rides;
+    int scannedConnections; // search effort
+
+    TimetableJourney() : found(false), departure(-1), arrival(-1), scannedConnections(0) {}
+};
+
+Timetable timetable;
+
+// "HH:MM" to minutes; hours may go past 24 for overnight runs. -1 if malformed
+int parseClock(const string& text) {
+    int hours, minutes;
+    char trailing;
+    if (sscanf(text.c_str(), "%d:%d%c", &hours, &minutes, &trailing) != 2 || hours < 0 || minutes < 0 ||
+        minutes > 59) {
+        return -1;
+    }
+    return hours * 60 + minutes;
+}
+
+// HH:MM on a 24-hour clock, with "(+N)" when the time falls N days after the query day
+string formatClock(int minutes) {
+    char text[32];
+    int days = minutes / MINUTES_PER_DAY;
+    minutes %= MINUTES_PER_DAY;
+    if (days > 0) snprintf(text, sizeof(text), "%02d:%02d (+%d)", minutes / 60, minutes % 60, days);
+    else snprintf(text, sizeof(text), "%02d:%02d", minutes / 60, minutes % 60);
+    return text;
+}
+
+bool connectionDepartsEarlier(const TimetableConnection& a, const TimetableConnection& b) {
+    return a.departure != b.departure ? a.departure < b.departure : a.arrival < b.arrival;
+}
+
+// Build the scan array: each connection shifted by every service day from firstDay to
+// the day after the query day, dropping copies that depart before the query day begins
+void finishTimetable(Timetable& table) {
+    table.tripStopStart.push_back(table.tripStops.size());
+    int latestDeparture = 0;
+    for (int i = 0; i < table.connections.size(); i++) {
+        latestDeparture = max(latestDeparture, table.connections[i].departure);
+    }
+    table.firstDay = -(latestDeparture / MINUTES_PER_DAY);
+    int tripCount = table.tripTrain.size();
+    table.scan.clear();
+    for (int day = table.firstDay; day <= 1; day++) {
+        for (int i = 0; i < table.connections.size(); i++) {
+            TimetableConnection shifted = table.connections[i];
+            shifted.departure += day * MINUTES_PER_DAY;
+            shifted.arrival += day * MINUTES_PER_DAY;
+            shifted.trip += (day - table.firstDay) * tripCount;
+            if (shifted.departure >= 0) table.scan.push_back(shifted);
+        }
+    }
+    sort(table.scan.begin(), table.scan.end(), connectionDepartsEarlier);
+}
+
+// Timetable files are CSV or TSV, one stop per line, each train's stops in order:
+//   T,<train number>,<station name>,<arrival HH:MM>,<departure HH:MM>
+// The first stop leaves the arrival empty and the last leaves the departure empty.
+bool loadTimetable(const string& path) {
+    ifstream in(path.c_str(), ios::binary);
+    if (!in) {
+        cerr << "Cannot open timetable file " << path << "\n";
+        return false;
+    }
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    unordered_map<string, int> stationByName;
+    for (int i = 0; i < stations.size(); i++) stationByName[stations[i].name] = i;
+    Timetable loaded;
+    vector<string> fields;
+    int lineNumber = 0, currentTrain = -1, lastStation = -1, lastDeparture = -1;
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == string::npos) lineEnd = text.size();
+        lineNumber++;
+        splitNetworkLine(text.data() + lineStart, text.data() + lineEnd, fields);
+        lineStart = lineEnd + 1;
+        if (fields[0].empty() || fields[0][0] == '#') continue;
+
+        unordered_map<string, int>::iterator station = fields.size() == 5 ? stationByName.find(fields[2]) : stationByName.end();
+        int train = fields.size() == 5 ? atoi(fields[1].c_str()) : 0;
+        int arrival = fields.size() == 5 && !fields[3].empty() ? parseClock(fields[3]) : -1;
+        int departure = fields.size() == 5 && !fields[4].empty() ? parseClock(fields[4]) : -1;
+        if ((fields[0] != "T" && fields[0] != "t") || station == stationByName.end() || train < 1 ||
+            train > MAX_TRAIN_NUMBER || (!fields[3].empty() && arrival == -1) || (!fields[4].empty() && departure == -1)) {
+            cerr << path << ":" << lineNumber << ": expected T,train,station,arrival,departure with a known station\n";
+            return false;
+        }
+
+        bool continuesTrip = train == currentTrain && lastDeparture != -1;
+        if (continuesTrip) {
+            if (arrival == -1 || arrival < lastDeparture || (departure != -1 && departure < arrival)) {
+                cerr << path << ":" << lineNumber << ": stop times must not go backwards\n";
+                return false;
+            }
+            TimetableConnection connection = { lastDeparture, arrival, lastStation, station->second,
+                                               (int)loaded.tripTrain.size() - 1 };
+            loaded.connections.push_back(connection);
+        } else if (departure != -1) {
+            loaded.tripTrain.push_back(train); // a new trip starts here
+            loaded.tripStopStart.push_back(loaded.tripStops.size());
+        }
+        if (continuesTrip || departure != -1) loaded.tripStops.push_back(station->second);
+        currentTrain = departure == -1 ? -1 : train;
+        lastStation = station->second;
+        lastDeparture = departure;
+    }
+
+    finishTimetable(loaded);
+    swap(timetable, loaded);
+    return true;
+}
+
+// Scratch space for timetable queries, kept between calls on the same thread
+struct TimetableSearch {
+    vector<int> arrival;         // earliest arrival at each station, INT_MAX until reached
+    vector<int> enterConnection; // boarding connection (scan index) of the ride that reached each station
+    vector<int> exitConnection;  // last connection of that ride
+    vector<int> runEntered;      // boarding connection of each run, -1 if not boarded
+};
+
+// Earliest arrival at destination leaving source no earlier than departureTime (minutes
+// after midnight of the query day)
+TimetableJourney findEarliestArrival(const Timetable& table, int source, int destination, int departureTime,
+                                     TimetableSearch& search) {
+    TimetableJourney journey;
+    int n = stations.size(), tripCount = table.tripTrain.size();
+    const vector<TimetableConnection>& scan = table.scan;
+    search.arrival.assign(n, INT_MAX);
+    search.enterConnection.assign(n, -1);
+    search.exitConnection.assign(n, -1);
+    search.runEntered.assign((size_t)(2 - table.firstDay) * tripCount, -1);
+    search.arrival[source] = departureTime;
+
+    TimetableConnection first = { departureTime, INT_MIN, 0, 0, 0 };
+    int index = lower_bound(scan.begin(), scan.end(), first, connectionDepartsEarlier) - scan.begin();
+    int* arrival = search.arrival.data();
+    int* runEntered = search.runEntered.data();
+    for (int end = scan.size(); index < end; index++) {
+        const TimetableConnection& connection = scan[index];
+        if (connection.departure >= arrival[destination]) break;
+        journey.scannedConnections++;
+        int& entered = runEntered[connection.trip];
+        if (entered == -1) {
+            int reachedAt = arrival[connection.from];
+            if (reachedAt == INT_MAX) continue;
+            if (reachedAt + (connection.from == source ? 0 : MIN_TRANSFER_MINUTES) > connection.departure) continue;
+            entered = index;
+        }
+        if (connection.arrival < arrival[connection.to]) {
+            arrival[connection.to] = connection.arrival;
+            search.enterConnection[connection.to] = entered;
+            search.exitConnection[connection.to] = index;
+        }
+    }
+    if (arrival[destination] == INT_MAX || source == destination) return journey;
+
+    // Walk the rides back from the destination
+    for (int at = destination; at != source; ) {
+        const TimetableConnection& enter = scan[search.enterConnection[at]];
+        const TimetableConnection& exit = scan[search.exitConnection[at]];
+        int trip = exit.trip % tripCount;
+        TimetableRide ride = { trip, table.tripTrain[trip], enter.from, at, enter.departure, exit.arrival,
+                               exit.trip / tripCount + table.firstDay };
+        journey.rides.push_back(ride);
+        at = enter.from;
+    }
+    reverse(journey.rides.begin(), journey.rides.end());
+    journey.found = true;
+    journey.departure = journey.rides.front().departure;
+    journey.arrival = journey.rides.back().arrival;
+    return journey;
+}
+
+TimetableJourney findEarliestArrival(int source, int destination, int departureTime) {
+    TimetableSearch search;
+    return findEarliestArrival(timetable, source, destination, departureTime, search);
+}
+
+// Stations a ride passes: the train's stops from boarding to alighting, with any stations
+// it runs through without stopping filled in from the track network. Empty if the track
+// network has no route between two of its stops. distance receives the km covered.
+vector<int> getRideRoute(const TimetableRide& ride, int& distance) {
+    vector<int> route(1, ride.fromStation);
+    distance = 0;
+    int stop = timetable.tripStopStart[ride.trip], lastStop = timetable.tripStopStart[ride.trip + 1];
+    while (stop < lastStop && timetable.tripStops[stop] != ride.fromStation) stop++;
+    for (stop++; stop < lastStop && route.back() != ride.toStation; stop++) {
+        RouteResult hop = findRoute(route.back(), timetable.tripStops[stop]);
+        if (!hop.found) return vector<int>();
+        route.insert(route.end(), hop.path.begin() + 1, hop.path.end());
+        distance += hop.totalDistance;
+    }
+    return route;
+}
+
+// Rides of a journey under a heading line (the heading is left out of JSON output)
+void displayJourney(const TimetableJourney& journey, const char* heading) {
+    int minutes = journey.arrival - journey.departure;
+    if (jsonOutput) {
+        JsonWriter json(screen);
+        json.beginResponse("journey");
+        json.key("found").boolean(true);
+        json.key("departure_minutes").integer(journey.departure);
+        json.key("arrival_minutes").integer(journey.arrival);
+        json.key("changes").integer(journey.rides.size() - 1);
+        json.key("rides").open('[');
+        for (int i = 0; i < journey.rides.size(); i++) {
+            const TimetableRide& ride = journey.rides[i];
+            json.open('{');
+            json.key("train").integer(ride.train);
+            json.key("from").text(stations[ride.fromStation].name);
+            json.key("to").text(stations[ride.toStation].name);
+            json.key("departure_minutes").integer(ride.departure);
+            json.key("arrival_minutes").integer(ride.arrival);
+            json.close('}');
+        }
+        json.close(']');
+        json.endResponse();
+        finishResponse();
+        return;
+    }
+
+    screen.append(heading);
+    screen.appendChar('\n');
+    for (int i = 0; i < journey.rides.size(); i++) {
+        const TimetableRide& ride = journey.rides[i];
+        screen.append("  Train ");
+        screen.appendInt(ride.train);
+        screen.append(": ");
+        screen.append(stations[ride.fromStation].name);
+        screen.appendChar(' ');
+        screen.append(formatClock(ride.departure));
+        screen.append(" -> ");
+        screen.append(stations[ride.toStation].name);
+        screen.appendChar(' ');
+        screen.append(formatClock(ride.arrival));
+        screen.appendChar('\n');
+    }
+    screen.append("Departs ");
+    screen.append(formatClock(journey.departure));
+    screen.append(", arrives ");
+    screen.append(formatClock(journey.arrival));
+    screen.append(" (");
+    screen.appendInt(minutes / 60);
+    screen.append("h ");
+    screen.appendInt(minutes % 60);
+    screen.append("m, changes: ");
+    screen.appendInt(journey.rides.size() - 1);
+    screen.append(")\n");
+    finishResponse();
+}
+
+// Booking System Functions
+
+// Function to display route path as string
+string getRoutePathString(const vector<int>& path) {
+    size_t length = 0;
+    for (int i = 0; i < path.size(); i++) length += stations[path[i]].name.size() + 4;
+    string routeStr;
+    routeStr.reserve(length);
+    for (int i = 0; i < path.size(); i++) {
+        if (i > 0) routeStr.append(" -> ", 4);
+        routeStr.append(stations[path[i]].name);
+    }
+    return routeStr;
+}
+
+// Multi-criteria routes: every route that no other route beats on distance, number of
+// legs and fare at once. Label-setting search in the style of Martins' algorithm:
+// labels (a partial route's criteria plus its parent label) live in one pool, each
+// station keeps the indices of its non-dominated labels, and labels leave a binary
+// heap in order of distance, then legs. Labels beaten at the destination are pruned.
+// Fare depends on the class, so the set is computed for one class at a time.
+const int MAX_PARETO_LABELS = 2000000; // give up on pathological networks rather than exhaust memory
+
+struct ParetoLabel {
+    int distance;
+    int legs;
+    int fare;
+    int station;
+    int parent; // label this one extends, -1 at the source
+    int weight; // km of the leg from the parent
+    bool dominated;
+};
+
+// Label pool and per-station bags, kept between calls so repeated queries reuse their storage
+struct ParetoSearch {
+    int labelLimit;               // labels created before the search gives up
+    bool truncated;               // the last search hit labelLimit, so its routes may be incomplete
+    vector<ParetoLabel> labels;
+    vector<vector<int> > bags;    // non-dominated labels at each station
+    vector<int> touchedStations;  // stations whose bag is non-empty, for cheap clearing
+    priority_queue<pair<pair<int, int>, int>, vector<pair<pair<int, int>, int> >,
+                   greater<pair<pair<int, int>, int> > > heap; // ((distance, legs), label)
+
+    ParetoSearch() : labelLimit(MAX_PARETO_LABELS), truncated(false) {}
+};
+
+bool paretoDominates(const ParetoLabel& a, const ParetoLabel& b) {
+    return a.distance <= b.distance && a.legs <= b.legs && a.fare <= b.fare;
+}
+
+// Add a label at its station unless a label already there (or at the destination) is at
+// least as good; labels it beats are marked so the heap skips them
+bool addParetoLabel(ParetoSearch& search, const ParetoLabel& label, int destination) {
+    const vector<int>& targetBag = search.bags[destination];
+    for (int i = 0; i < targetBag.size(); i++) {
+        if (paretoDominates(search.labels[targetBag[i]], label)) return false;
+    }
+    vector<int>& bag = search.bags[label.station];
+    for (int i = 0; i < bag.size(); i++) {
+        if (paretoDominates(search.labels[bag[i]], label)) return false;
+    }
+    int kept = 0;
+    for (int i = 0; i < bag.size(); i++) {
+        if (paretoDominates(label, search.labels[bag[i]])) search.labels[bag[i]].dominated = true;
+        else bag[kept++] = bag[i];
+    }
+    bag.resize(kept);
+    if (bag.empty()) search.touchedStations.push_back(label.station);
+    bag.push_back(search.labels.size());
+    search.labels.push_back(label);
+    search.heap.push(make_pair(make_pair(label.distance, label.legs), (int)search.labels.size() - 1));
+    return true;
+}
+
+// Pareto-optimal routes from source to destination for one ticket class, shortest first.
+// If the label limit is hit, search.truncated is set and the routes are those found so far.
+vector<RouteResult> findParetoRoutes(int source, int destination, TicketClass ticketClass,
+                                     const StationGraph& graph, ParetoSearch& search) {
+    search.labels.clear();
+    for (int i = 0; i < search.touchedStations.size(); i++) search.bags[search.touchedStations[i]].clear();
+    search.touchedStations.clear();
+    search.bags.resize(graph.stationCount);
+    while (!search.heap.empty()) search.heap.pop();
+
+    ParetoLabel start = { 0, 0, 0, source, -1, 0, false };
+    addParetoLabel(search, start, destination);
+    while (!search.heap.empty() && search.labels.size() < search.labelLimit) {
+        int index = search.heap.top().second;
+        search.heap.pop();
+        if (search.labels[index].dominated) continue;
+        ParetoLabel label = search.labels[index];
+        if (label.station == destination) continue;
+
+        for (int j = graph.offsets[label.station]; j < graph.offsets[label.station + 1]; j++) {
+            int v = graph.neighbors[j];
+            if (v == source) continue;
+            ParetoLabel next = { label.distance + graph.weights[j], label.legs + 1, 0, v, index, graph.weights[j], false };
+            next.fare = getFareForClass(next.distance, ticketClass);
+            addParetoLabel(search, next, destination);
+        }
+    }
+    search.truncated = !search.heap.empty();
+
+    vector<RouteResult> routes;
+    const vector<int>& bag = search.bags[destination];
+    for (int i = 0; i < bag.size() && source != destination; i++) {
+        RouteResult route;
+        for (int at = bag[i]; at != -1; at = search.labels[at].parent) {
+            route.path.push_back(search.labels[at].station);
+            if (search.labels[at].parent != -1) route.legDistances.push_back(search.labels[at].weight);
+        }
+        reverse(route.path.begin(), route.path.end());
+        reverse(route.legDistances.begin(), route.legDistances.end());
+        finishRoute(route);
+        route.settledNodes = search.labels.size();
+        routes.push_back(route);
+    }
+    sort(routes.begin(), routes.end(), [](const RouteResult& a, const RouteResult& b) {
+        return a.totalDistance < b.totalDistance;
+    });
+    return routes;
+}
+
+// List the alternatives to the shortest route that take fewer legs
+void displayParetoRoutes(int source, int destination, TicketClass ticketClass) {
+    ParetoSearch search;
+    vector<RouteResult> routes = findParetoRoutes(source, destination, ticketClass, getStationGraph(), search);
+    if (routes.size() <= 1 && !search.truncated) return;
+    if (jsonOutput) {
+        JsonWriter json(screen);
+        json.beginResponse("alternatives");
+        json.key("class").text(getClassString(ticketClass));
+        json.key("truncated").boolean(search.truncated);
+        json.key("routes").open('[');
+        for (int i = 0; i < routes.size(); i++) {
+            json.open('{');
+            json.key("distance_km").integer(routes[i].totalDistance);
+            json.key("legs").integer(routes[i].legDistances.size());
+            json.key("fare").integer(getFareForClass(routes[i].totalDistance, ticketClass));
+            json.key("path");
+            appendJsonPath(json, routes[i].path);
+            json.close('}');
+        }
+        json.close(']');
+        json.endResponse();
+        finishResponse();
+        return;
+    }
+
+    screen.append("\nAlternative Routes (");
+    screen.append(getClassString(ticketClass));
+    screen.append("):\n");
+    for (int i = 0; i < routes.size(); i++) {
+        screen.append("  ");
+        screen.appendInt(routes[i].totalDistance);
+        screen.append(" km, ");
+        screen.appendInt(routes[i].legDistances.size());
+        screen.append(" legs, ₹");
+        screen.appendInt(getFareForClass(routes[i].totalDistance, ticketClass));
+        screen.append(": ");
+        appendRoutePath(screen, routes[i].path);
+        screen.appendChar('\n');
+    }
+    if (search.truncated) {
+        screen.append("  (alternatives truncated: the search stopped after ");
+        screen.appendInt(search.labelLimit);
+        screen.append(" labels)\n");
+    }
+    finishResponse();
+}
+
+// K shortest loopless routes (Yen's algorithm). Each next route branches off an earlier
+// one at some spur station: a search from the spur that may not revisit the stations
+// before it, nor leave it the way an earlier route with the same beginning did. The
+// spur searches are A* guided by exact distances to the destination on the open
+// network (one reverse tree per query), which blocking can only lengthen. They share
+// one workspace whose arrays are stamped with a per-search generation, so starting a
+// search costs nothing however large the network is.
+const int ALTERNATIVE_ROUTE_COUNT = 10; // routes tried when the shortest one is sold out
+const int MAX_ROUTE_ALTERNATIVES = 50;  // largest k a server client may ask for
+
+struct KShortestSearch {
+    vector<int> dist;
+    vector<int> prev;
+    vector<int> prevWeight;
+    vector<unsigned> reached;     // dist/prev are valid when this equals generation
+    vector<unsigned> settled;
+    vector<unsigned> blocked;     // station may not be entered in this search
+    vector<unsigned> blockedNext; // station may not be entered straight from the spur
+    vector<pair<int, int> > heap; // lazy min-heap of (distance + remaining, station)
+    ShortestPathTree toDestination; // remaining km from every station, INT_MAX if it cannot get there
+    unsigned generation;
+
+    KShortestSearch() : generation(0) {}
+
+    // Start a new search; stamps from earlier searches become stale
+    void begin(int stationCount) {
+        if (dist.size() != stationCount) {
+            dist.assign(stationCount, 0);
+            prev.assign(stationCount, -1);
+            prevWeight.assign(stationCount, 0);
+            reached.assign(stationCount, 0);
+            settled.assign(stationCount, 0);
+            blocked.assign(stationCount, 0);
+            blockedNext.assign(stationCount, 0);
+            generation = 0;
+        }
+        if (++generation == 0) {
+            fill(reached.begin(), reached.end(), 0);
+            fill(settled.begin(), settled.end(), 0);
+            fill(blocked.begin(), blocked.end(), 0);
+            fill(blockedNext.begin(), blockedNext.end(), 0);
+            generation = 1;
+        }
+        heap.clear();
+    }
+};
+
+// Shortest route from spur to destination avoiding the stations and spur exits marked
+// for the current generation; appended to route, which already holds the root path
+bool extendBySpurSearch(const StationGraph& graph, KShortestSearch& search, int spur, int destination,
+                        RouteResult& route) {
+    unsigned generation = search.generation;
+    const vector<int>& remaining = search.toDestination.dist;
+    greater<pair<int, int> > later;
+    if (remaining[spur] == INT_MAX) return false;
+    search.dist[spur] = 0;
+    search.prev[spur] = -1;
+    search.reached[spur] = generation;
+    search.heap.push_back(make_pair(remaining[spur], spur));
+    while (!search.heap.empty()) {
+        pop_heap(search.heap.begin(), search.heap.end(), later);
+        int u = search.heap.back().second;
+        search.heap.pop_back();
+        if (search.settled[u] == generation) continue;
+        search.settled[u] = generation;
+        if (u == destination) break;
+
+        for (int j = graph.offsets[u]; j < graph.offsets[u + 1]; j++) {
+            int v = graph.neighbors[j];
+            if (remaining[v] == INT_MAX || search.blocked[v] == generation ||
+                (u == spur && search.blockedNext[v] == generation)) {
+                continue;
+            }
+            int candidate = search.dist[u] + graph.weights[j];
+            if (search.reached[v] != generation || candidate < search.dist[v]) {
+                search.reached[v] = generation;
+                search.dist[v] = candidate;
+                search.prev[v] = u;
+                search.prevWeight[v] = graph.weights[j];
+                search.heap.push_back(make_pair(candidate + remaining[v], v));
+                push_heap(search.heap.begin(), search.heap.end(), later);
+            }
+        }
+    }
+    if (search.settled[destination] != generation) return false;
+
+    size_t rootStations = route.path.size(), rootLegs = route.legDistances.size();
+    for (int at = destination; at != spur; at = search.prev[at]) {
+        route.path.push_back(at);
+        route.legDistances.push_back(search.prevWeight[at]);
+    }
+    reverse(route.path.begin() + rootStations, route.path.end());
+    reverse(route.legDistances.begin() + rootLegs, route.legDistances.end());
+    return true;
+}
+
+// Up to k loopless routes from source to destination, shortest first
+vector<RouteResult> findKShortestRoutes(int source, int destination, int k, const StationGraph& graph,
+                                        KShortestSearch& search) {
+    vector<RouteResult> accepted, candidates;
+    if (k <= 0 || source == destination) return accepted;
+    computeShortestPathTree(graph, destination, search.toDestination); // arcs run both ways
+    RouteResult first;
+    first.path.push_back(source);
+    search.begin(graph.stationCount);
+    if (!extendBySpurSearch(graph, search, source, destination, first)) return accepted;
+    finishRoute(first);
+    accepted.push_back(first);
+
+    while (accepted.size() < k) {
+        const vector<int> previous = accepted.back().path;
+        const vector<int> previousLegs = accepted.back().legDistances;
+        for (int i = 0; i + 1 < previous.size(); i++) {
+            search.begin(graph.stationCount);
+            for (int r = 0; r < i; r++) search.blocked[previous[r]] = search.generation;
+            for (int a = 0; a < accepted.size(); a++) {
+                const vector<int>& path = accepted[a].path;
+                if (path.size() > i + 1 && equal(previous.begin(), previous.begin() + i + 1, path.begin())) {
+                    search.blockedNext[path[i + 1]] = search.generation;
+                }
+            }
+
+            RouteResult candidate;
+            candidate.path.assign(previous.begin(), previous.begin() + i + 1);
+            candidate.legDistances.assign(previousLegs.begin(), previousLegs.begin() + i);
+            if (!extendBySpurSearch(graph, search, previous[i], destination, candidate)) continue;
+            bool known = false;
+            for (int c = 0; c < candidates.size() && !known; c++) known = candidates[c].path == candidate.path;
+            if (known) continue;
+            finishRoute(candidate);
+            candidates.push_back(candidate);
+        }
+        if (candidates.empty()) break;
+
+        int best = 0;
+        for (int c = 1; c < candidates.size(); c++) {
+            if (candidates[c].totalDistance < candidates[best].totalDistance ||
+                (candidates[c].totalDistance == candidates[best].totalDistance &&
+                 candidates[c].path.size() < candidates[best].path.size())) {
+                best = c;
+            }
+        }
+        accepted.push_back(candidates[best]);
+        candidates[best] = candidates.back();
+        candidates.pop_back();
+    }
+    return accepted;
+}
+
+vector<RouteResult> findKShortestRoutes(int source, int destination, int k) {
+    KShortestSearch search;
+    return findKShortestRoutes(source, destination, k, getStationGraph(), search);
+}
+
+// Helper function to get shortest distance between two stations
+int getShortestDistance(int from, int to) {
+    const DistanceMatrix* matrix = getDistanceMatrix();
+    if (matrix != NULL) {
+        uint32_t distance = matrix->distance[(size_t)from * matrix->stationCount + to];
+        return from == to || distance == UNREACHABLE_DISTANCE ? -1 : (int)distance;
+    }
+
+    RouteResult route = findRoute(from, to);
+    if (route.path.size() <= 1) return -1; // No path available
+    return route.totalDistance;
+}
+
+// Days since 1970-01-01 for a Gregorian calendar date
+int daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// YYYY-MM-DD for a travel day (days since 1970-01-01, never negative)
+string formatTravelDay(int days) {
+    days += 719468;
+    int era = days / 146097;
+    int dayOfEra = days - era * 146097;
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int shiftedMonth = (5 * dayOfYear + 2) / 153;
+    int day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    int month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+    int year = yearOfEra + era * 400 + (month <= 2);
+    char text[32];
+    snprintf(text, sizeof(text), "%04d-%02d-%02d", year, month, day);
+    return text;
+}
+
+// Travel day for a YYYY-MM-DD date, or -1 if it is not a real date the ledger can store
+int parseTravelDay(const string& text) {
+    int year, month, day;
+    char trailing;
+    if (sscanf(text.c_str(), "%d-%d-%d%c", &year, &month, &day, &trailing) != 3 ||
+        month < 1 || month > 12 || day < 1 || day > 31) {
+        return -1;
+    }
+    int days = daysFromCivil(year, month, day);
+    if (days < 0 || days > MAX_TRAVEL_DAY) return -1;
+    // Dates like 2025-02-30 roll over into the next month
+    char normalized[32];
+    snprintf(normalized, sizeof(normalized), "%04d-%02d-%02d", year, month, day);
+    return formatTravelDay(days) == normalized ? days : -1;
+}
+
+// Seat Inventory
+//
+// Seats sold per (train, travel day, class, track segment). A booking takes one seat
+// on every segment of its route or none at all. Counters are created on first use in
+// independently locked shards; the shard lock only covers that lookup, and the counts
+// themselves move by compare-and-swap, so bookings on different trains or segments
+// never wait on each other and no counter can pass the class capacity.
+struct SeatInventoryShard {
+    mutex lock;
+    unordered_map<uint64_t, atomic<int> > sold; // nodes never move, so counters can be used unlocked
+};
+
+struct SeatInventory {
+    static const int SHARD_COUNT = 64;
+    SeatInventoryShard shards[SHARD_COUNT];
+    int capacity[5]; // seats per train and day, indexed by TicketClass
+
+    SeatInventory() {
+        capacity[0] = 0;
+        capacity[GENERAL] = 90;
+        capacity[SLEEPER] = 72;
+        capacity[AC] = 64;
+        capacity[FIRST_CLASS] = 24;
+    }
+
+    // 17 bits of train, 16 of day, 3 of class and 28 of segment
+    static uint64_t key(int train, int day, TicketClass tClass, int segment) {
+        return ((uint64_t)train << 47) | ((uint64_t)day << 31) | ((uint64_t)tClass << 28) | (segment & 0xFFFFFFF);
+    }
+
+    atomic<int>& counter(uint64_t k) {
+        SeatInventoryShard& shard = shards[(k * 0x9E3779B97F4A7C15ULL) >> 58];
+        lock_guard<mutex> guard(shard.lock);
+        return shard.sold.emplace(piecewise_construct, forward_as_tuple(k), forward_as_tuple(0)).first->second;
+    }
+
+    atomic<int>& counter(int train, int day, TicketClass tClass, int from, int to) {
+        return counter(key(train, day, tClass, getSegmentId(from, to)));
+    }
+
+    static const int RESERVE_ATTEMPTS = 2;
+
+    // Take a seat on every leg of route; returns -1 on success, otherwise the index of a
+    // sold-out leg (and nothing is taken). Legs are taken in segment order, so requests for
+    // overlapping routes meet on their first shared segment instead of each holding a seat
+    // the other needs. A leg can still look full only because a request that is about to
+    // roll back holds its last seat, so a refusal is retried once before it stands.
+    int reserve(int train, int day, TicketClass tClass, const vector<int>& route) {
+        thread_local vector<pair<int, int> > legs; // (segment, index in route)
+        legs.clear();
+        for (int i = 0; i + 1 < (int)route.size(); i++) {
+            legs.push_back(make_pair(getSegmentId(route[i], route[i + 1]), i));
+        }
+        sort(legs.begin(), legs.end());
+
+        int limit = capacity[tClass], soldOutLeg = -1;
+        for (int attempt = 0; attempt < RESERVE_ATTEMPTS; attempt++) {
+            if (attempt > 0) this_thread::yield();
+            int taken = 0;
+            for (; taken < legs.size(); taken++) {
+                atomic<int>& sold = counter(key(train, day, tClass, legs[taken].first));
+                int current = sold.load();
+                while (current < limit && !sold.compare_exchange_weak(current, current + 1)) {}
+                if (current >= limit) break;
+            }
+            if (taken == legs.size()) return -1;
+            soldOutLeg = legs[taken].second;
+            for (int i = 0; i < taken; i++) counter(key(train, day, tClass, legs[i].first))--;
+        }
+        return soldOutLeg;
+    }
+
+    // Give back the seats on the first legCount legs of route
+    void release(int train, int day, TicketClass tClass, const vector<int>& route, int legCount) {
+        for (int i = 0; i < legCount; i++) {
+            counter(train, day, tClass, route[i], route[i + 1])--;
+        }
+    }
+
+    void release(int train, int day, TicketClass tClass, const vector<int>& route) {
+        release(train, day, tClass, route, (int)route.size() - 1);
+    }
+
+    // Seats left on one leg
+    int available(int train, int day, TicketClass tClass, int from, int to) {
+        return capacity[tClass] - counter(train, day, tClass, from, to).load();
+    }
+
+    // Drop every counter; only safe while no other thread is using the inventory
+    void clear() {
+        for (int i = 0; i < SHARD_COUNT; i++) shards[i].sold.clear();
+    }
+};
+
+SeatInventory seatInventory;
+
+// Route of a booked ticket, as stored in the ledger
+vector<int> getBookedRoute(const BookingLedger& ledger, int slot) {
+    return vector<int>(ledger.routeStations.begin() + ledger.routeStart[slot],
+                       ledger.routeStations.begin() + ledger.routeEnd(slot));
+}
+
+// Recount sold seats from the active bookings after a restore; bookings that predate
+// the inventory have no stored route and hold no seats
+void rebuildSeatInventory() {
+    seatInventory.clear();
+    for (int s = 0; s < BOOKING_SHARD_COUNT; s++) {
+        const BookingLedger& ledger = bookingShards[s].ledger;
+        for (int slot = 0; slot < ledger.size(); slot++) {
+            if (!ledger.isActive(slot)) continue;
+            vector<int> route = getBookedRoute(ledger, slot);
+            for (int i = 0; i + 1 < (int)route.size(); i++) {
+                seatInventory.counter(ledger.train[slot], ledger.travelDay[slot],
+                                      (TicketClass)ledger.ticketClass[slot], route[i], route[i + 1])++;
+            }
+        }
+    }
+}
+
+BookingShard& bookingShardFor(int userId) {
+    return bookingShards[userId % BOOKING_SHARD_COUNT];
+}
+
+// One booking copied out of its shard, so it can be shown after the shard is unlocked
+struct BookingRecord {
+    int ticketNumber;
+    string passengerName;
+    int age;
+    int fromStation;
+    int toStation;
+    TicketClass ticketClass;
+    int distance;
+    int fare;
+    int train;      // 0 for bookings made before trains were recorded
+    int travelDay;
+    bool active;
+};
+
+void copyBooking(const BookingLedger& ledger, int slot, BookingRecord& record) {
+    record.ticketNumber = ledger.ticketNumber[slot];
+    record.passengerName = ledger.getPassengerName(slot);
+    record.age = ledger.age[slot];
+    record.fromStation = ledger.fromStation[slot];
+    record.toStation = ledger.toStation[slot];
+    record.ticketClass = (TicketClass)ledger.ticketClass[slot];
+    record.distance = ledger.distance[slot];
+    record.fare = ledger.fare[slot];
+    record.train = ledger.train[slot];
+    record.travelDay = ledger.travelDay[slot];
+    record.active = ledger.isActive(slot);
+}
+
+// Append a booking to its owner's shard and journal it, returning the journal sequence; the
+// caller holds the shard lock, so a snapshot never sees a booking stored but not journaled
+long long appendBooking(BookingShard& shard, int ticketNumber, int userId, const string& passengerName, int age,
+                   int fromStation, int toStation, TicketClass ticketClass, int distance, int fare, int train,
+                   int travelDay, const vector<int>& route) {
+    int slot = shard.ledger.append(ticketNumber, passengerName, age, fromStation, toStation,
+                                   ticketClass, distance, fare, userId, train, travelDay, route);
+    shard.slotByTicket[ticketNumber] = slot;
+    int listIndex = userId / BOOKING_SHARD_COUNT;
+    if (listIndex >= shard.slotsByUser.size()) shard.slotsByUser.resize(listIndex + 1);
+    shard.slotsByUser[listIndex].push_back(slot);
+    return journalBooking(ticketNumber, userId, passengerName, age, fromStation, toStation, ticketClass, distance,
+                          fare, train, travelDay, route);
+}
+
+// Store a booking under a ticket number that is already allocated, as when replaying
+void storeBooking(int ticketNumber, int userId, const string& passengerName, int age, int fromStation,
+                  int toStation, TicketClass ticketClass, int distance, int fare, int train, int travelDay,
+                  const vector<int>& route) {
+    BookingShard& shard = bookingShardFor(userId);
+    lock_guard<mutex> guard(shard.lock);
+    appendBooking(shard, ticketNumber, userId, passengerName, age, fromStation, toStation, ticketClass, distance,
+                  fare, train, travelDay, route);
+}
+
+// Store a confirmed booking under the next ticket number and return that number; safe to
+// call from any number of threads at once. The number is taken under the shard lock, so
+// each shard, and so each user's booking list, stays in ticket order. journaled receives
+// the journal sequence to pass to syncJournal.
+int recordBooking(int userId, const string& passengerName, int age, int fromStation, int toStation,
+                  TicketClass ticketClass, int distance, int fare, int train, int travelDay,
+                  const vector<int>& route, long long* journaled = NULL) {
+    BookingShard& shard = bookingShardFor(userId);
+    lock_guard<mutex> guard(shard.lock);
+    int ticketNumber = nextTicketNumber.fetch_add(1);
+    long long sequence = appendBooking(shard, ticketNumber, userId, passengerName, age, fromStation, toStation,
+                                       ticketClass, distance, fare, train, travelDay, route);
+    if (journaled != NULL) *journaled = sequence;
+    return ticketNumber;
+}
+
+// Cancel an active ticket owned by userId and give its seats back. Returns false if there
+// is nothing to cancel; otherwise cancelled receives the booking and journaled the journal
+// sequence to pass to syncJournal.
+bool cancelTicket(int userId, int ticketNumber, BookingRecord& cancelled, long long* journaled = NULL) {
+    BookingShard& shard = bookingShardFor(userId);
+    lock_guard<mutex> guard(shard.lock);
+    unordered_map<int, int>::iterator it = shard.slotByTicket.find(ticketNumber);
+    if (it == shard.slotByTicket.end()) return false;
+    int slot = it->second;
+    BookingLedger& ledger = shard.ledger;
+    if (ledger.userId[slot] != userId || !ledger.isActive(slot)) return false;
+    ledger.setActive(slot, false);
+    if (!replayingJournal) {
+        seatInventory.release(ledger.train[slot], ledger.travelDay[slot], (TicketClass)ledger.ticketClass[slot],
+                              getBookedRoute(ledger, slot));
+    }
+    long long sequence = journalCancel(userId, ticketNumber);
+    if (journaled != NULL) *journaled = sequence;
+    copyBooking(ledger, slot, cancelled);
+    return true;
+}
+
+// Every booking of one user, oldest first
+void getUserBookings(int userId, vector<BookingRecord>& records) {
+    BookingShard& shard = bookingShardFor(userId);
+    lock_guard<mutex> guard(shard.lock);
+    records.clear();
+    int listIndex = userId / BOOKING_SHARD_COUNT;
+    if (listIndex >= shard.slotsByUser.size()) return;
+    const vector<int>& slots = shard.slotsByUser[listIndex];
+    records.resize(slots.size());
+    for (int i = 0; i < slots.size(); i++) copyBooking(shard.ledger, slots[i], records[i]);
+}
+
+int bookingCount() {
+    int total = 0;
+    for (int s = 0; s < BOOKING_SHARD_COUNT; s++) {
+        lock_guard<mutex> guard(bookingShards[s].lock);
+        total += bookingShards[s].ledger.size();
+    }
+    return total;
+}
+
+// Drop every booking and start ticket numbers over; only safe while nothing else books
+void clearBookings() {
+    for (int s = 0; s < BOOKING_SHARD_COUNT; s++) {
+        bookingShards[s].ledger = BookingLedger();
+        bookingShards[s].slotByTicket.clear();
+        bookingShards[s].slotsByUser.clear();
+    }
+    nextTicketNumber = FIRST_TICKET_NUMBER;
+}
+
+// Hold every shard lock, always in index order, while a snapshot copies the shards
+void lockBookingShards() {
+    for (int s = 0; s < BOOKING_SHARD_COUNT; s++) bookingShards[s].lock.lock();
+}
+
+void unlockBookingShards() {
+    for (int s = BOOKING_SHARD_COUNT - 1; s >= 0; s--) bookingShards[s].lock.unlock();
+}
+
+// Snapshots: the whole user store and booking ledger as length-prefixed raw arrays,
+// so a restart maps the file and copies each column in one go instead of replaying events
+
+template <typename T> void writeSection(ofstream& out, const T* data, uint64_t count) {
+    out.write((const char*)&count, sizeof(count));
+    out.write((const char*)data, count * sizeof(T));
+}
+
+template <typename T> void writeSection(ofstream& out, const vector<T>& column) {
+    writeSection(out, column.data(), column.size());
+}
+
+template <typename T> bool readSection(RecordReader& reader, vector<T>& column) {
+    uint64_t count;
+    if (!reader.get(count) || (uint64_t)(reader.end - reader.at) / sizeof(T) < count) return false;
+    column.assign((const T*)reader.at, (const T*)reader.at + count);
+    reader.at += count * sizeof(T);
+    return true;
+}
+
+string snapshotPath() { return dataDirectory + "/snapshot.bin"; }
+string journalPath() { return dataDirectory + "/journal.log"; }
+
+// Where a snapshot moves the journal of `generation` until the snapshot that covers it is written
+string rotatedJournalPath(uint32_t generation) { return journalPath() + "." + to_string(generation); }
+
+// Write the users and a copy of the booking shards, taken when the next ticket number was
+// ticketLimit. Users are read in place, so this runs on the thread that registers them.
+bool writeSnapshot(const string& path, uint32_t generation, const vector<BookingShard>& shards, int ticketLimit) {
+    string temporaryPath = path + ".tmp";
+    {
+        ofstream out(temporaryPath.c_str(), ios::binary | ios::trunc);
+        if (!out) return false;
+        // The file keeps one ledger in ticket order, so the shards are merged first
+        vector<pair<int, pair<int, int> > > order; // (ticket, (shard, slot))
+        for (int s = 0; s < BOOKING_SHARD_COUNT; s++) {
+            const BookingLedger& ledger = shards[s].ledger;
+            for (int slot = 0; slot < ledger.size(); slot++) {
+                order.push_back(make_pair(ledger.ticketNumber[slot], make_pair(s, slot)));
+            }
+        }
+        sort(order.begin(), order.end());
+        BookingLedger bookings;
+        vector<int> ticketSlots(ticketLimit - FIRST_TICKET_NUMBER, -1);
+        for (int i = 0; i < order.size(); i++) {
+            bookings.appendRow(shards[order[i].second.first].ledger, order[i].second.second);
+            ticketSlots[order[i].first - FIRST_TICKET_NUMBER] = i;
+        }
+
+        uint32_t header[6] = { SNAPSHOT_MAGIC, PERSISTENCE_FORMAT_VERSION, generation,
+                               (uint32_t)ticketLimit, (uint32_t)users.size(), (uint32_t)bookings.size() };
+        out.write((const char*)header, sizeof(header));
+
+        // Users: name arena, then passwords and booking lists flattened into arrays
+        StringPool passwords;
+        vector<uint32_t> nameOffsets, passwordOffsets;
+        vector<uint64_t> bookingListOffsets(1, 0);
+        vector<int> bookingIds;
+        for (int i = 0; i < users.size(); i++) {
+            nameOffsets.push_back(users[i].nameOffset);
+            passwordOffsets.push_back(passwords.add(users[i].password));
+            const BookingShard& shard = shards[i % BOOKING_SHARD_COUNT];
+            int listIndex = i / BOOKING_SHARD_COUNT;
+            for (int j = 0; listIndex < shard.slotsByUser.size() && j < shard.slotsByUser[listIndex].size(); j++) {
+                bookingIds.push_back(shard.ledger.ticketNumber[shard.slotsByUser[listIndex][j]]);
+            }
+            bookingListOffsets.push_back(bookingIds.size());
+        }
+        writeSection(out, userNames.bytes);
+        writeSection(out, nameOffsets);
+        writeSection(out, passwords.bytes);
+        writeSection(out, passwordOffsets);
+        writeSection(out, bookingListOffsets);
+        writeSection(out, bookingIds);
+
+        writeSection(out, bookings.ticketNumber);
+        writeSection(out, bookings.fromStation);
+        writeSection(out, bookings.toStation);
+        writeSection(out, bookings.ticketClass);
+        writeSection(out, bookings.age);
+        writeSection(out, bookings.distance);
+        writeSection(out, bookings.fare);
+        writeSection(out, bookings.userId);
+        writeSection(out, bookings.passengerName);
+        writeSection(out, bookings.activeBits);
+        writeSection(out, bookings.passengerNames.bytes);
+        writeSection(out, ticketSlots);
+        writeSection(out, bookings.train);
+        writeSection(out, bookings.travelDay);
+        writeSection(out, bookings.routeStart);
+        writeSection(out, bookings.routeStations);
+        if (!out.flush()) return false;
+    }
+
+    // Make the snapshot durable before it replaces the previous one
+    int fd = ::open(temporaryPath.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced && rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+// Map a snapshot and bulk-copy its columns into memory; returns false if it is missing or damaged
+bool loadSnapshot(const string& path, uint32_t& generation) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < 24) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+    madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+
+    RecordReader reader((const char*)mapped, (const char*)mapped + info.st_size);
+    uint32_t header[6];
+    for (int i = 0; i < 6; i++) reader.get(header[i]);
+    bool ok = header[0] == SNAPSHOT_MAGIC && header[1] >= OLDEST_PERSISTENCE_VERSION &&
+              header[1] <= PERSISTENCE_FORMAT_VERSION;
+
+    StringPool names, passwords;
+    vector<uint32_t> nameOffsets, passwordOffsets;
+    vector<uint64_t> bookingListOffsets;
+    vector<int> bookingIds, ticketSlots;
+    BookingLedger bookings;
+    ok = ok && readSection(reader, names.bytes) && readSection(reader, nameOffsets) &&
+         readSection(reader, passwords.bytes) && readSection(reader, passwordOffsets) &&
+         readSection(reader, bookingListOffsets) && readSection(reader, bookingIds);
+    ok = ok && readSection(reader, bookings.ticketNumber) && readSection(reader, bookings.fromStation) &&
+         readSection(reader, bookings.toStation) && readSection(reader, bookings.ticketClass) &&
+         readSection(reader, bookings.age) && readSection(reader, bookings.distance) &&
+         readSection(reader, bookings.fare) && readSection(reader, bookings.userId) &&
+         readSection(reader, bookings.passengerName) && readSection(reader, bookings.activeBits) &&
+         readSection(reader, bookings.passengerNames.bytes) && readSection(reader, ticketSlots);
+    if (ok && header[1] >= 2) {
+        ok = readSection(reader, bookings.train) && readSection(reader, bookings.travelDay) &&
+             readSection(reader, bookings.routeStart) && readSection(reader, bookings.routeStations);
+    } else if (ok) {
+        // Version 1 bookings have no train, day or route, and so hold no seats
+        bookings.train.assign(header[5], 0);
+        bookings.travelDay.assign(header[5], 0);
+        bookings.routeStart.assign(header[5], 0);
+        bookings.routeStations.clear();
+    }
+    ok = ok && nameOffsets.size() == header[4] && passwordOffsets.size() == header[4] &&
+         bookingListOffsets.size() == header[4] + 1 && bookings.ticketNumber.size() == header[5] &&
+         bookings.train.size() == header[5] && bookings.travelDay.size() == header[5] &&
+         bookings.routeStart.size() == header[5] && bookings.fromStation.size() == header[5] &&
+         bookings.toStation.size() == header[5] && bookings.ticketClass.size() == header[5] &&
+         bookings.age.size() == header[5] && bookings.distance.size() == header[5] &&
+         bookings.fare.size() == header[5] && bookings.userId.size() == header[5] &&
+         bookings.passengerName.size() == header[5] && bookings.activeBits.size() == (header[5] + 63) / 64;
+    // Every offset and index is checked before anything is copied out, so a damaged file
+    // cannot make the copies below read past their arrays
+    for (int i = 0; ok && i < nameOffsets.size(); i++) {
+        ok = names.holds(nameOffsets[i]) && passwords.holds(passwordOffsets[i]);
+    }
+    for (int slot = 0; ok && slot < bookings.size(); slot++) {
+        ok = bookings.userId[slot] >= 0 && bookings.userId[slot] < header[4] &&
+             bookings.passengerNames.holds(bookings.passengerName[slot]) &&
+             bookings.routeStart[slot] <= bookings.routeEnd(slot) &&
+             bookings.routeEnd(slot) <= bookings.routeStations.size();
+    }
+
+    if (ok) {
+        generation = header[2];
+        nextTicketNumber = header[3];
+        userNames.bytes.swap(names.bytes);
+        users.resize(header[4]);
+        for (int i = 0; i < users.size(); i++) {
+            users[i].nameOffset = nameOffsets[i];
+            users[i].password = passwords.get(passwordOffsets[i]);
+            userIndex.insert(i);
+        }
+        // Each user's bookings go to the user's shard; the rows are in ticket order, which
+        // is also the order of every user's booking list
+        for (int slot = 0; slot < bookings.size(); slot++) {
+            int userId = bookings.userId[slot];
+            BookingShard& shard = bookingShardFor(userId);
+            int shardSlot = shard.ledger.appendRow(bookings, slot);
+            shard.slotByTicket[bookings.ticketNumber[slot]] = shardSlot;
+            int listIndex = userId / BOOKING_SHARD_COUNT;
+            if (listIndex >= shard.slotsByUser.size()) shard.slotsByUser.resize(listIndex + 1);
+            shard.slotsByUser[listIndex].push_back(shardSlot);
+        }
+    }
+    munmap(mapped, info.st_size);
+    return ok;
+}
+
+const int JOURNAL_HEADER_BYTES = 12; // magic, format version, generation
+
+// Re-apply journal events recorded after the snapshot; returns the length of the valid
+// prefix (a torn final record from a crash is ignored), 0 if there is no journal yet (the
+// file is missing or shorter than its header), or -1 if its header is foreign, newer or of
+// another generation. version receives the journal's format version.
+off_t replayJournal(const string& path, uint32_t generation, uint32_t& version) {
+    ifstream in(path.c_str(), ios::binary);
+    if (!in) return 0;
+    vector<char> contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    if (contents.size() < JOURNAL_HEADER_BYTES) return 0;
+    RecordReader reader(contents.data(), contents.data() + contents.size());
+    uint32_t magic = 0, fileGeneration = 0;
+    reader.get(magic);
+    reader.get(version);
+    reader.get(fileGeneration);
+    if (magic != JOURNAL_MAGIC || version < OLDEST_PERSISTENCE_VERSION || version > PERSISTENCE_FORMAT_VERSION ||
+        fileGeneration != generation) {
+        return -1;
+    }
+
+    replayingJournal = true;
+    const char* validEnd = reader.at;
+    while (true) {
+        uint32_t length, checksum = 0;
+        if (!reader.get(length) || reader.end - reader.at < (ptrdiff_t)length + 4) break;
+        RecordReader payload(reader.at, reader.at + length);
+        reader.at += length;
+        reader.get(checksum);
+        if (checksum != checksumBytes(payload.at, length)) break;
+
+        // A record that passes its checksum but does not decode means a foreign or newer file
+        uint8_t type = 0;
+        bool decoded = payload.get(type);
+        if (type == EVENT_REGISTER) {
+            string username, password;
+            decoded = payload.getString(username) && payload.getString(password);
+            if (decoded) createUser(username, password);
+        } else if (type == EVENT_BOOK) {
+            int32_t ticketNumber, userId;
+            uint8_t age, ticketClass;
+            uint16_t fromStation, toStation;
+            uint32_t distance, fare, train = 0, routeLength = 0;
+            uint16_t travelDay = 0;
+            string passengerName;
+            decoded = payload.get(ticketNumber) && payload.get(userId) && payload.getString(passengerName) &&
+                      payload.get(age) && payload.get(fromStation) && payload.get(toStation) &&
+                      payload.get(ticketClass) && payload.get(distance) && payload.get(fare) &&
+                      userId >= 0 && userId < users.size();
+            if (decoded && version >= 2) {
+                decoded = payload.get(train) && payload.get(travelDay) && payload.get(routeLength) &&
+                          (uint32_t)(payload.end - payload.at) / sizeof(uint16_t) >= routeLength;
+            }
+            vector<int> route;
+            for (uint32_t i = 0; decoded && i < routeLength; i++) {
+                uint16_t station = 0;
+                payload.get(station);
+                route.push_back(station);
+            }
+            if (decoded) {
+                // Bookings from different shards may reach the journal out of ticket order
+                storeBooking(ticketNumber, userId, passengerName, age, fromStation, toStation,
+                             (TicketClass)ticketClass, distance, fare, train, travelDay, route);
+                if (ticketNumber >= nextTicketNumber) nextTicketNumber = ticketNumber + 1;
+            }
+        } else if (type == EVENT_CANCEL) {
+            int32_t userId, ticketNumber;
+            decoded = payload.get(userId) && payload.get(ticketNumber) && userId >= 0 && userId < users.size();
+            BookingRecord cancelled;
+            if (decoded) cancelTicket(userId, ticketNumber, cancelled);
+        } else {
+            decoded = false;
+        }
+        if (!decoded) break;
+        validEnd = reader.at;
+    }
+    replayingJournal = false;
+    return validEnd - contents.data();
+}
+
+// Snapshot the current state. With every shard locked, the shards are copied and the
+// journal is moved aside and restarted for the next generation, so the copy holds exactly
+// the events in the old journal; bookings and cancellations only wait for that. The
+// snapshot is then written unlocked and the old journal deleted. A crash before the
+// snapshot is in place leaves the moved journal, which startup replays before journal.log.
+// Registrations run on the same thread as the snapshot (the state writer, or the console).
+bool takeSnapshot() {
+    if (!journal.isOpen()) return false;
+    uint32_t generation = journalGeneration;
+    vector<BookingShard> shards(BOOKING_SHARD_COUNT);
+    lockBookingShards();
+    for (int s = 0; s < BOOKING_SHARD_COUNT; s++) {
+        shards[s].ledger = bookingShards[s].ledger;
+        shards[s].slotsByUser = bookingShards[s].slotsByUser;
+    }
+    int ticketLimit = nextTicketNumber;
+    journal.close();
+    if (rename(journalPath().c_str(), rotatedJournalPath(generation).c_str()) != 0) {
+        cerr << "Could not move journal to " << rotatedJournalPath(generation) << ": " << strerror(errno) << "\n";
+        // Keep appending to it; everything it held was flushed by close
+        struct stat info;
+        if (stat(journalPath().c_str(), &info) != 0 || !journal.open(journalPath(), generation, info.st_size)) {
+            cerr << "Could not reopen journal " << journalPath() << ": " << strerror(errno) << "\n";
+        }
+        unlockBookingShards();
+        return false;
+    }
+    journalGeneration++;
+    journal.recordsSinceSnapshot = 0;
+    bool reopened = journal.open(journalPath(), journalGeneration, 0);
+    unlockBookingShards();
+    if (!reopened) {
+        cerr << "Could not open journal " << journalPath() << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    if (!writeSnapshot(snapshotPath(), journalGeneration, shards, ticketLimit)) {
+        cerr << "Could not write snapshot to " << snapshotPath() << "\n";
+        return false;
+    }
+    unlink(rotatedJournalPath(generation).c_str());
+    return true;
+}
+
+bool snapshotDue() {
+    return journal.isOpen() && journal.recordsSinceSnapshot >= snapshotInterval;
+}
+
+void maybeTakeSnapshot() {
+    if (snapshotDue()) takeSnapshot();
+}
+
+// Generation recorded in a journal's header; false if there is no complete header
+bool readJournalGeneration(const string& path, uint32_t& generation) {
+    ifstream in(path.c_str(), ios::binary);
+    uint32_t header[3];
+    if (!in.read((char*)header, sizeof(header)) || header[0] != JOURNAL_MAGIC) return false;
+    generation = header[2];
+    return true;
+}
+
+// Load the latest snapshot, replay the journal on top and reopen it for appending.
+// A journal in an older format is not appended to; it is folded into a fresh snapshot.
+// Nothing on disk is thrown away: a snapshot that does not load, or a journal that does
+// not follow it, stops startup instead of being replaced by an empty one.
+bool openDataDirectory() {
+    mkdir(dataDirectory.c_str(), 0755);
+    journalGeneration = 0;
+    struct stat info;
+    if (stat(snapshotPath().c_str(), &info) == 0 && !loadSnapshot(snapshotPath(), journalGeneration)) {
+        cerr << "Snapshot " << snapshotPath() << " is damaged or from a newer version; not starting\n";
+        return false;
+    }
+
+    // A crash after a snapshot is written but before the next journal is started leaves
+    // the previous generation's journal, whose events are all in the snapshot. It is kept
+    // under its generation number rather than overwritten.
+    uint32_t staleGeneration;
+    if (readJournalGeneration(journalPath(), staleGeneration) && staleGeneration + 1 == journalGeneration) {
+        string keptPath = rotatedJournalPath(staleGeneration);
+        if (rename(journalPath().c_str(), keptPath.c_str()) != 0) {
+            cerr << "Could not move stale journal to " << keptPath << ": " << strerror(errno) << "\n";
+            return false;
+        }
+    }
+
+    // Journals moved aside by a snapshot that never completed come first, oldest first
+    uint32_t snapshotGeneration = journalGeneration;
+    uint32_t journalVersion = PERSISTENCE_FORMAT_VERSION;
+    while (stat(rotatedJournalPath(journalGeneration).c_str(), &info) == 0) {
+        if (replayJournal(rotatedJournalPath(journalGeneration), journalGeneration, journalVersion) == -1) {
+            cerr << "Journal " << rotatedJournalPath(journalGeneration) << " does not follow snapshot generation "
+                 << snapshotGeneration << " or is from a newer version; not starting\n";
+            return false;
+        }
+        journalGeneration++;
+    }
+
+    off_t validLength = replayJournal(journalPath(), journalGeneration, journalVersion);
+    if (validLength == -1) {
+        cerr << "Journal " << journalPath() << " does not belong to snapshot generation " << journalGeneration
+             << " or is from a newer version; not starting\n";
+        return false;
+    }
+    rebuildSeatInventory();
+    if (!journal.open(journalPath(), journalGeneration, validLength)) {
+        cerr << "Could not open journal " << journalPath() << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    if (journalGeneration == snapshotGeneration &&
+        (validLength == 0 || journalVersion == PERSISTENCE_FORMAT_VERSION)) {
+        return true;
+    }
+    // Fold the moved journals, or one in an older format, into a fresh snapshot
+    if (!takeSnapshot()) return false;
+    for (uint32_t generation = snapshotGeneration; generation + 1 < journalGeneration; generation++) {
+        unlink(rotatedJournalPath(generation).c_str());
+    }
+    return true;
+}
+
+// Booking against the timetable: the earliest journey from the chosen departure time,
+// with one ticket per train ride. Seats on every ride are held before any ticket is issued.
+void bookTimetabledJourney(Session& session, const string& passengerName, int age, int fromStation, int toStation) {
+    string travelDate, clock;
+    cout << "Enter travel date (YYYY-MM-DD): ";
+    cin >> travelDate;
+    int travelDay = parseTravelDay(travelDate);
+    if (travelDay == -1) {
+        cout << "Invalid travel date!\n";
+        return;
+    }
+    cout << "Enter earliest departure time (HH:MM): ";
+    cin >> clock;
+    int departureTime = parseClock(clock);
+    if (departureTime == -1 || departureTime >= MINUTES_PER_DAY) {
+        cout << "Invalid departure time!\n";
+        return;
+    }
+
+    TimetableJourney journey = findEarliestArrival(fromStation, toStation, departureTime);
+    if (!journey.found) {
+        cout << "No scheduled journey between the selected stations.\n";
+        return;
+    }
+    vector<vector<int> > rideRoutes;
+    vector<int> rideDistances;
+    for (int i = 0; i < journey.rides.size(); i++) {
+        const TimetableRide& ride = journey.rides[i];
+        int distance;
+        rideRoutes.push_back(getRideRoute(ride, distance));
+        rideDistances.push_back(distance);
+        int day = travelDay + ride.serviceDay;
+        if (rideRoutes.back().empty() || day < 0 || day > MAX_TRAVEL_DAY) {
+            cout << "Train " << ride.train << " cannot be booked on this network.\n";
+            return;
+        }
+    }
+
+    displayJourney(journey, "\n=== Scheduled Journey ===");
+
+    displayFareOptions();
+    cout << "Select ticket class (1-4): ";
+    int classChoice;
+    cin >> classChoice;
+    if (classChoice < 1 || classChoice > 4) {
+        cout << "Invalid ticket class selection!\n";
+        return;
+    }
+    TicketClass selectedClass = static_cast<TicketClass>(classChoice);
+
+    OperationTimer timer(METRIC_BOOK);
+    for (int i = 0; i < journey.rides.size(); i++) {
+        const TimetableRide& ride = journey.rides[i];
+        int soldOutLeg = seatInventory.reserve(ride.train, travelDay + ride.serviceDay, selectedClass, rideRoutes[i]);
+        if (soldOutLeg == -1) continue;
+        for (int j = 0; j < i; j++) {
+            seatInventory.release(journey.rides[j].train, travelDay + journey.rides[j].serviceDay, selectedClass,
+                                  rideRoutes[j]);
+        }
+        cout << "Sorry, no " << getClassString(selectedClass) << " seats are left on train " << ride.train
+             << " between " << stations[rideRoutes[i][soldOutLeg]].name << " and "
+             << stations[rideRoutes[i][soldOutLeg + 1]].name << ".\n";
+        return;
+    }
+
+    vector<int> ticketNumbers, fares;
+    int totalFare = 0;
+    long long journaled = 0; // the last ride's record; sequences only grow, so it covers the rest
+    for (int i = 0; i < journey.rides.size(); i++) {
+        const TimetableRide& ride = journey.rides[i];
+        int fare = getPassengerFare(rideDistances[i], selectedClass, age);
+        ticketNumbers.push_back(recordBooking(session.userId, passengerName, age, ride.fromStation, ride.toStation,
+                                              selectedClass, rideDistances[i], fare, ride.train,
+                                              travelDay + ride.serviceDay, rideRoutes[i], &journaled));
+        fares.push_back(fare);
+        totalFare += fare;
+    }
+    if (!syncJournal(journaled)) {
+        cout << "The booking could not be saved: the journal is unavailable.\n";
+        return;
+    }
+    timer.stop();
+    const AgeConcession* concession = findConcession(age);
+
+    if (jsonOutput) {
+        JsonWriter json(screen);
+        json.beginResponse("booking");
+        json.key("passenger").text(passengerName);
+        json.key("age").integer(age);
+        json.key("class").text(getClassString(selectedClass));
+        json.key("tickets").open('[');
+        for (int i = 0; i < journey.rides.size(); i++) {
+            const TimetableRide& ride = journey.rides[i];
+            json.open('{');
+            json.key("ticket").integer(ticketNumbers[i]);
+            json.key("train").integer(ride.train);
+            json.key("travel_date").text(formatTravelDay(travelDay + ride.serviceDay));
+            json.key("from").text(stations[ride.fromStation].name);
+            json.key("to").text(stations[ride.toStation].name);
+            json.key("departure_minutes").integer(ride.departure);
+            json.key("arrival_minutes").integer(ride.arrival);
+            json.key("distance_km").integer(rideDistances[i]);
+            json.key("fare").integer(fares[i]);
+            json.close('}');
+        }
+        json.close(']');
+        if (concession != NULL) json.key("concession").text(concession->name);
+        json.key("total_fare").integer(totalFare);
+        json.key("status").text("confirmed");
+        json.endResponse();
+        finishResponse();
+        return;
+    }
+
+    screen.append("\n=== Booking Confirmation ===\nPassenger Name: ");
+    screen.append(passengerName);
+    screen.append("\nAge: ");
+    screen.appendInt(age);
+    screen.append("\nClass: ");
+    screen.append(getClassString(selectedClass));
+    screen.appendChar('\n');
+    for (int i = 0; i < journey.rides.size(); i++) {
+        const TimetableRide& ride = journey.rides[i];
+        screen.append("Ticket #");
+        screen.appendInt(ticketNumbers[i]);
+        screen.append(": train ");
+        screen.appendInt(ride.train);
+        screen.append(", ");
+        screen.append(stations[ride.fromStation].name);
+        screen.appendChar(' ');
+        screen.append(formatClock(ride.departure));
+        screen.append(" -> ");
+        screen.append(stations[ride.toStation].name);
+        screen.appendChar(' ');
+        screen.append(formatClock(ride.arrival));
+        screen.append(", ");
+        screen.appendInt(rideDistances[i]);
+        screen.append(" km, ₹");
+        screen.appendInt(fares[i]);
+        screen.appendChar('\n');
+    }
+    if (concession != NULL) {
+        screen.append("Concession: ");
+        screen.append(concession->name);
+        screen.append(" (");
+        screen.appendInt(concession->percentOff);
+        screen.append("% off)\n");
+    }
+    screen.append("Total Fare: ₹");
+    screen.appendInt(totalFare);
+    screen.append("\nStatus: Confirmed\n\nBooking successful! Please save your ticket numbers.\n");
+    finishResponse();
+}
+
+void bookTicket(Session& session) {
+    if (!session.loggedIn()) {
+        cout << "Please login first to book a ticket!\n";
+        return;
+    }
+    
+    cout << "\n=== Ticket Booking ===\n";
+    
+    // Get passenger details
+    string passengerName;
+    int age;
+    cout << "Enter passenger name: ";
+    cin.ignore();
+    getline(cin, passengerName);
+    cout << "Enter passenger age: ";
+    cin >> age;
+    if (age < 0 || age > MAX_PASSENGER_AGE) {
+        cout << "Invalid passenger age!\n";
+        return;
+    }
+    
+    // Select stations
+    displayStations();
+    int fromStation, toStation;
+    cout << "Enter source station index: ";
+    cin >> fromStation;
+    cout << "Enter destination station index: ";
+    cin >> toStation;
+    
+    if (fromStation < 0 || fromStation >= stations.size() || 
+        toStation < 0 || toStation >= stations.size() || 
+        fromStation == toStation || max(fromStation, toStation) >= MAX_BOOKABLE_STATIONS) {
+        cout << "Invalid station selection!\n";
+        return;
+    }
+    if (!timetable.empty()) {
+        bookTimetabledJourney(session, passengerName, age, fromStation, toStation);
+        return;
+    }
+    
+    // Calculate shortest path using optimized Dijkstra
+    RouteResult route = findRoute(fromStation, toStation);
+    if (route.path.size() <= 1) {
+        cout << "No available path between selected stations.\n";
+        return;
+    }
+    
+    int totalDistance = route.totalDistance;
+    TimeInfo timeInfo(totalDistance);
+    
+    if (jsonOutput) {
+        JsonWriter json(screen);
+        json.beginResponse("route");
+        json.key("from").text(stations[fromStation].name);
+        json.key("to").text(stations[toStation].name);
+        json.key("found").boolean(true);
+        json.key("distance_km").integer(totalDistance);
+        json.key("travel_minutes").integer(timeInfo.totalMinutes());
+        json.key("path");
+        appendJsonPath(json, route.path);
+        json.endResponse();
+    } else {
+        screen.append("\n=== Route Details ===\nFrom: ");
+        screen.append(stations[fromStation].name);
+        screen.append("\nTo: ");
+        screen.append(stations[toStation].name);
+        screen.append("\nDistance: ");
+        screen.appendInt(totalDistance);
+        screen.append(" km\nRoute Path: ");
+        appendRoutePath(screen, route.path);
+        screen.append("\nEstimated Travel Time: ");
+        appendTravelTime(screen, timeInfo);
+        screen.appendChar('\n');
+    }
+    finishResponse();
+    
+    // Select train and date
+    int train;
+    string travelDate;
+    cout << "Enter train number: ";
+    cin >> train;
+    if (train < 1 || train > MAX_TRAIN_NUMBER) {
+        cout << "Invalid train number!\n";
+        return;
+    }
+    cout << "Enter travel date (YYYY-MM-DD): ";
+    cin >> travelDate;
+    int travelDay = parseTravelDay(travelDate);
+    if (travelDay == -1) {
+        cout << "Invalid travel date!\n";
+        return;
+    }
+    
+    // Select ticket class
+    displayFareOptions();
+    cout << "Select ticket class (1-4): ";
+    int classChoice;
+    cin >> classChoice;
+    
+    if (classChoice < 1 || classChoice > 4) {
+        cout << "Invalid ticket class selection!\n";
+        return;
+    }
+    
+    TicketClass selectedClass = static_cast<TicketClass>(classChoice);
+    int fare = getPassengerFare(totalDistance, selectedClass, age);
+    
+    // Hold a seat on every segment before issuing the ticket
+    OperationTimer timer(METRIC_BOOK);
+    int soldOutLeg = seatInventory.reserve(train, travelDay, selectedClass, route.path);
+    if (soldOutLeg != -1) {
+        cout << "Sorry, no " << getClassString(selectedClass) << " seats are left on train " << train
+             << " on " << formatTravelDay(travelDay) << " between " << stations[route.path[soldOutLeg]].name
+             << " and " << stations[route.path[soldOutLeg + 1]].name << ".\n";
+
+        // Offer the shortest of the next-best routes that still has seats
+        vector<RouteResult> alternatives = findKShortestRoutes(fromStation, toStation, ALTERNATIVE_ROUTE_COUNT);
+        int chosen = -1;
+        for (int r = 1; r < alternatives.size() && chosen == -1; r++) {
+            if (seatInventory.reserve(train, travelDay, selectedClass, alternatives[r].path) == -1) chosen = r;
+        }
+        if (chosen == -1) return;
+        const RouteResult& alternative = alternatives[chosen];
+        cout << "Seats are available on a longer route: " << getRoutePathString(alternative.path) << " ("
+             << alternative.totalDistance << " km, ₹" << getPassengerFare(alternative.totalDistance, selectedClass, age)
+             << ")\n";
+        cout << "Book this route instead? (y/n): ";
+        string answer;
+        cin >> answer;
+        if (answer != "y" && answer != "Y") {
+            seatInventory.release(train, travelDay, selectedClass, alternative.path);
+            return;
+        }
+        timer.restart();
+        route = alternative;
+        totalDistance = route.totalDistance;
+        timeInfo = TimeInfo(totalDistance);
+        fare = getPassengerFare(totalDistance, selectedClass, age);
+    }
+    
+    // Create booking
+    long long journaled = 0;
+    int ticketNumber = recordBooking(session.userId, passengerName, age, fromStation, toStation,
+                                     selectedClass, totalDistance, fare, train, travelDay, route.path, &journaled);
+    if (!syncJournal(journaled)) {
+        cout << "The booking could not be saved: the journal is unavailable.\n";
+        return;
+    }
+    timer.stop();
+    
+    // Display booking confirmation
+    const AgeConcession* concession = findConcession(age);
+    if (jsonOutput) {
+        JsonWriter json(screen);
+        json.beginResponse("booking");
+        json.key("ticket").integer(ticketNumber);
+        json.key("passenger").text(passengerName);
+        json.key("age").integer(age);
+        json.key("from").text(stations[fromStation].name);
+        json.key("to").text(stations[toStation].name);
+        json.key("train").integer(train);
+        json.key("travel_date").text(formatTravelDay(travelDay));
+        json.key("class").text(getClassString(selectedClass));
+        json.key("distance_km").integer(totalDistance);
+        json.key("travel_minutes").integer(timeInfo.totalMinutes());
+        json.key("path");
+        appendJsonPath(json, route.path);
+        if (concession != NULL) json.key("concession").text(concession->name);
+        json.key("fare").integer(fare);
+        json.key("status").text("confirmed");
+        json.endResponse();
+        finishResponse();
+        return;
+    }
+
+    screen.append("\n=== Booking Confirmation ===\nTicket Number: ");
+    screen.appendInt(ticketNumber);
+    screen.append("\nPassenger Name: ");
+    screen.append(passengerName);
+    screen.append("\nAge: ");
+    screen.appendInt(age);
+    screen.append("\nFrom: ");
+    screen.append(stations[fromStation].name);
+    screen.append("\nTo: ");
+    screen.append(stations[toStation].name);
+    screen.append("\nTrain: ");
+    screen.appendInt(train);
+    screen.append(" on ");
+    screen.append(formatTravelDay(travelDay));
+    screen.append("\nClass: ");
+    screen.append(getClassString(selectedClass));
+    screen.append("\nDistance: ");
+    screen.appendInt(totalDistance);
+    screen.append(" km\nTravel Time: ");
+    appendTravelTime(screen, timeInfo);
+    screen.appendChar('\n');
+    if (concession != NULL) {
+        screen.append("Concession: ");
+        screen.append(concession->name);
+        screen.append(" (");
+        screen.appendInt(concession->percentOff);
+        screen.append("% off)\n");
+    }
+    screen.append("Fare: ₹");
+    screen.appendInt(fare);
+    screen.append("\nStatus: Confirmed\n\nBooking successful! Please save your ticket number.\n");
+    finishResponse();
+}
+
+void viewMyBookings(const Session& session) {
+    if (!session.loggedIn()) {
+        cout << "Please login first!\n";
+        return;
+    }
+    
+    vector<BookingRecord> records;
+    getUserBookings(session.userId, records);
+    if (jsonOutput) {
+        JsonWriter json(screen);
+        json.beginResponse("bookings");
+        json.key("bookings").open('[');
+        for (int t = 0; t < records.size(); t++) {
+            const BookingRecord& booking = records[t];
+            json.open('{');
+            json.key("ticket").integer(booking.ticketNumber);
+            json.key("passenger").text(booking.passengerName);
+            json.key("age").integer(booking.age);
+            json.key("from").text(stations[booking.fromStation].name);
+            json.key("to").text(stations[booking.toStation].name);
+            if (booking.train != 0) {
+                json.key("train").integer(booking.train);
+                json.key("travel_date").text(formatTravelDay(booking.travelDay));
+            }
+            json.key("class").text(getClassString(booking.ticketClass));
+            json.key("distance_km").integer(booking.distance);
+            json.key("travel_minutes").integer(TimeInfo(booking.distance).totalMinutes());
+            json.key("fare").integer(booking.fare);
+            json.key("status").text(booking.active ? "active" : "cancelled");
+            json.close('}');
+        }
+        json.close(']');
+        json.endResponse();
+        finishResponse();
+        return;
+    }
+
+    screen.append("\n=== My Bookings ===\n");
+    for (int t = 0; t < records.size(); t++) {
+        const BookingRecord& booking = records[t];
+        screen.append("\n--- Ticket #");
+        screen.appendInt(booking.ticketNumber);
+        screen.append(" ---\nPassenger: ");
+        screen.append(booking.passengerName);
+        screen.append("\nAge: ");
+        screen.appendInt(booking.age);
+        screen.append("\nFrom: ");
+        screen.append(stations[booking.fromStation].name);
+        screen.append("\nTo: ");
+        screen.append(stations[booking.toStation].name);
+        screen.appendChar('\n');
+        if (booking.train != 0) {
+            screen.append("Train: ");
+            screen.appendInt(booking.train);
+            screen.append(" on ");
+            screen.append(formatTravelDay(booking.travelDay));
+            screen.appendChar('\n');
+        }
+        screen.append("Class: ");
+        screen.append(getClassString(booking.ticketClass));
+        screen.append("\nDistance: ");
+        screen.appendInt(booking.distance);
+        screen.append(" km\nTravel Time: ");
+        appendTravelTime(screen, TimeInfo(booking.distance));
+        screen.append("\nFare: ₹");
+        screen.appendInt(booking.fare);
+        screen.append("\nStatus: ");
+        screen.append(booking.active ? "Active" : "Cancelled");
+        screen.appendChar('\n');
+    }
+    if (records.empty()) {
+        screen.append("No bookings found.\n");
+    }
+    finishResponse();
+}
+
+void cancelBooking(Session& session) {
+    if (!session.loggedIn()) {
+        cout << "Please login first!\n";
+        return;
+    }
+    
+    cout << "\n=== Cancel Booking ===\n";
+    cout << "Enter ticket number to cancel: ";
+    int ticketNumber;
+    cin >> ticketNumber;
+    
+    OperationTimer timer(METRIC_CANCEL);
+    BookingRecord booking;
+    long long journaled = 0;
+    if (cancelTicket(session.userId, ticketNumber, booking, &journaled)) {
+        if (!syncJournal(journaled)) {
+            cout << "The cancellation could not be saved: the journal is unavailable.\n";
+            return;
+        }
+        timer.stop();
+        if (jsonOutput) {
+            JsonWriter json(screen);
+            json.beginResponse("cancellation");
+            json.key("ticket").integer(ticketNumber);
+            json.key("passenger").text(booking.passengerName);
+            json.key("from").text(stations[booking.fromStation].name);
+            json.key("to").text(stations[booking.toStation].name);
+            json.key("refund").integer(booking.fare);
+            json.endResponse();
+        } else {
+            screen.append("\nTicket #");
+            screen.appendInt(ticketNumber);
+            screen.append(" has been cancelled successfully.\nPassenger: ");
+            screen.append(booking.passengerName);
+            screen.append("\nRoute: ");
+            screen.append(stations[booking.fromStation].name);
+            screen.append(" -> ");
+            screen.append(stations[booking.toStation].name);
+            screen.append("\nRefund Amount: ₹");
+            screen.appendInt(booking.fare);
+            screen.appendChar('\n');
+        }
+        finishResponse();
+        return;
+    }
+    
+    cout << "Ticket not found or already cancelled!\n";
+}
+
+double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Close, reopen or re-measure a track segment between two adjacent stations
+void manageTrackWorks() {
+    cout << "\n=== Track Works ===\n";
+    cout << "1. Close a Segment\n";
+    cout << "2. Reopen a Segment\n";
+    cout << "3. Change Segment Length\n";
+    cout << "Enter your choice: ";
+    int choice;
+    cin >> choice;
+    if (choice < 1 || choice > 3) {
+        cout << "Invalid choice!\n";
+        return;
+    }
+
+    displayStations();
+    cout << "Enter first station index: ";
+    int a;
+    cin >> a;
+    cout << "Enter second station index: ";
+    int b;
+    cin >> b;
+    if (a < 0 || a >= stations.size() || b < 0 || b >= stations.size() || a == b) {
+        cout << "Invalid station indices!\n";
+        return;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (choice == 1) {
+        if (!closeConnection(a, b)) {
+            cout << "There is no open segment between these stations!\n";
+            return;
+        }
+        cout << "Segment " << stations[a].name << " - " << stations[b].name << " closed";
+    } else if (choice == 2) {
+        if (!reopenConnection(a, b)) {
+            cout << "This segment is not closed!\n";
+            return;
+        }
+        cout << "Segment " << stations[a].name << " - " << stations[b].name << " reopened ("
+             << getConnectionDistance(a, b) << " km)";
+    } else {
+        cout << "Enter new length in km: ";
+        int km;
+        cin >> km;
+        if (!setConnectionDistance(a, b, km)) {
+            cout << "There is no open segment between these stations, or the length is invalid!\n";
+            return;
+        }
+        cout << "Segment " << stations[a].name << " - " << stations[b].name << " is now " << km << " km";
+    }
+    cout << "; routes updated in " << fixed << setprecision(2) << elapsedMs(start) << " ms.\n";
+}
+
+// Distances and predecessors from src for the single-source listings: read from
+// the all-pairs matrix when it is enabled, otherwise one heap-based Dijkstra
+void singleSourceShortestPaths(int src, vector<int>& dist, vector<int>& prev) {
+    const DistanceMatrix* matrix = getDistanceMatrix();
+    if (matrix == NULL) {
+        ShortestPathTree tree;
+        computeShortestPathTree(getStationGraph(), src, tree);
+        recordSearch(SEARCH_TREE, tree.settleOrder.size(), tree.relaxedEdges, tree.heapPushes);
+        dist.swap(tree.dist);
+        prev.swap(tree.prev);
+        return;
+    }
+
+    // The hop from each station back towards src is its predecessor on a route from src
+    size_t n = matrix->stationCount;
+    dist.assign(n, INT_MAX);
+    prev.assign(n, -1);
+    for (size_t i = 0; i < n; i++) {
+        size_t cell = i * n + src;
+        if (matrix->distance[cell] == UNREACHABLE_DISTANCE) continue;
+        dist[i] = matrix->distance[cell];
+        if (i != src) prev[i] = matrix->nextHop[cell];
+    }
+}
+
+void dijkstraWithPath(int src, int dest = -1) {
+    if (dest != -1) {
+        // Use optimized Dijkstra for specific route
+        RouteResult route = findRoute(src, dest);
+        bool found = route.path.size() > 1;
+        int totalDistance = route.totalDistance;
+
+        if (jsonOutput) {
+            JsonWriter json(screen);
+            json.beginResponse("route");
+            json.key("from").text(stations[src].name);
+            json.key("to").text(stations[dest].name);
+            json.key("found").boolean(found);
+            if (found) {
+                json.key("distance_km").integer(totalDistance);
+                json.key("path");
+                appendJsonPath(json, route.path);
+                json.key("legs").open('[');
+                for (int i = 0; i < route.legDistances.size(); i++) {
+                    json.open('{');
+                    json.key("from").text(stations[route.path[i]].name);
+                    json.key("to").text(stations[route.path[i + 1]].name);
+                    json.key("distance_km").integer(route.legDistances[i]);
+                    json.key("arrive_after_minutes").integer((int)(route.cumulativeHours[i + 1] * 60 + 0.5));
+                    json.close('}');
+                }
+                json.close(']');
+            }
+            json.endResponse();
+        } else {
+            screen.append("\n=== Route Information ===\nFrom: ");
+            screen.append(stations[src].name);
+            screen.append("\nTo: ");
+            screen.append(stations[dest].name);
+            screen.appendChar('\n');
+            if (found) {
+                screen.append("Distance: ");
+                screen.appendInt(totalDistance);
+                screen.append(" km\nRoute: ");
+                appendRoutePath(screen, route.path);
+                screen.append("\nLegs:\n");
+                for (int i = 0; i < route.legDistances.size(); i++) {
+                    int minutes = (int)(route.cumulativeHours[i + 1] * 60 + 0.5);
+                    screen.append("  ");
+                    screen.append(stations[route.path[i]].name);
+                    screen.append(" -> ");
+                    screen.append(stations[route.path[i + 1]].name);
+                    screen.append(": ");
+                    screen.appendInt(route.legDistances[i]);
+                    screen.append(" km (arrive after ");
+                    screen.appendInt(minutes / 60);
+                    screen.append("h ");
+                    screen.appendInt(minutes % 60);
+                    screen.append("m)\n");
+                }
+            } else {
+                screen.append("No route available!\n");
+            }
+        }
+        finishResponse();
+        if (!found) return;
+
+        if (!timetable.empty()) {
+            cout << "Enter departure time for the timetable (HH:MM): ";
+            string clock;
+            cin >> clock;
+            int departureTime = parseClock(clock);
+            TimetableJourney journey;
+            if (departureTime != -1 && departureTime < MINUTES_PER_DAY) {
+                journey = findEarliestArrival(src, dest, departureTime);
+            }
+            if (journey.found) {
+                displayJourney(journey, "Earliest scheduled journey:");
+            } else if (jsonOutput) {
+                JsonWriter json(screen);
+                json.beginResponse("journey");
+                json.key("found").boolean(false);
+                json.endResponse();
+                finishResponse();
+            } else {
+                cout << "No scheduled journey from that time.\n";
+            }
+        }
+        
+        // Get fare class choice
+        displayFareOptions();
+        cout << "Select ticket class (1-4): ";
+        int classChoice;
+        cin >> classChoice;
+        
+        if (classChoice >= 1 && classChoice <= 4) {
+            calculateFare(totalDistance, static_cast<TicketClass>(classChoice));
+            displayParetoRoutes(src, dest, static_cast<TicketClass>(classChoice));
+        } else {
+            cout << "Invalid choice! Showing all fares:\n";
+            calculateFare(totalDistance, GENERAL);
+        }
+    } else {
+        // Show all shortest paths from the shared single-source engine
+        int n = stations.size();
+        vector<int> dist, prev, path;
+        singleSourceShortestPaths(src, dist, prev);
+
+        if (jsonOutput) {
+            JsonWriter json(screen);
+            json.beginResponse("paths");
+            json.key("from").text(stations[src].name);
+            json.key("routes").open('[');
+            for (int i = 0; i < n; i++) {
+                if (i == src) continue;
+                json.open('{');
+                json.key("to").text(stations[i].name);
+                json.key("reachable").boolean(dist[i] != INT_MAX);
+                if (dist[i] != INT_MAX) {
+                    collectTreePath(prev, i, src, path);
+                    json.key("distance_km").integer(dist[i]);
+                    json.key("path");
+                    appendJsonPath(json, path);
+                }
+                json.close('}');
+            }
+            json.close(']');
+            json.endResponse();
+        } else {
+            screen.append("\nShortest distances and routes from ");
+            screen.append(stations[src].name);
+            screen.append(":\n");
+            for (int i = 0; i < n; i++) {
+                if (i == src) continue;
+                screen.append("\nTo ");
+                screen.append(stations[i].name);
+                screen.append(": ");
+                if (dist[i] == INT_MAX) {
+                    screen.append("Not Reachable\n");
+                    continue;
+                }
+                screen.appendInt(dist[i]);
+                screen.append(" km\nRoute: ");
+                collectTreePath(prev, i, src, path);
+                if (path.empty()) screen.append("No path exists");
+                else appendRoutePath(screen, path);
+                screen.appendChar('\n');
+            }
+        }
+        finishResponse();
+    }
+}
+
+void dijkstra(int src) {
+    int n = stations.size();
+    vector<int> dist, prev;
+    singleSourceShortestPaths(src, dist, prev);
+
+    if (jsonOutput) {
+        JsonWriter json(screen);
+        json.beginResponse("distances");
+        json.key("from").text(stations[src].name);
+        json.key("distances").open('[');
+        for (int i = 0; i < n; i++) {
+            json.open('{');
+            json.key("to").text(stations[i].name);
+            json.key("reachable").boolean(dist[i] != INT_MAX);
+            if (dist[i] != INT_MAX) json.key("distance_km").integer(dist[i]);
+            json.close('}');
+        }
+        json.close(']');
+        json.endResponse();
+    } else {
+        screen.append("\nShortest distances from ");
+        screen.append(stations[src].name);
+        screen.append(":\n");
+        for (int i = 0; i < n; i++) {
+            screen.append(stations[i].name);
+            screen.append(": ");
+            if (dist[i] == INT_MAX) {
+                screen.append("Not Reachable\n");
+            } else {
+                screen.appendInt(dist[i]);
+                screen.append(" km\n");
+            }
+        }
+    }
+    finishResponse();
+}
+
+// Request Server
+//
+// A line protocol over local TCP; every request gets exactly one response line:
+//   ROUTE <from> <to>                     OK <km> <station> ... <station>
+//   FARE <from> <to> <class>              OK <km> <minutes> <fare>
+//   ROUTES <from> <to> <k>                OK <count> [<km> <station>,...,<station>]...
+//   REGISTER <username> <password>        OK <user id>
+//   LOGIN <username> <password>           OK
+//   LOGOUT                                OK
+//   BOOK <from> <to> <class> <train> <YYYY-MM-DD> <age> <passenger name>
+//                                         OK <ticket> <fare>
+//   CANCEL <ticket>                       OK <refund>
+//   BOOKINGS                              OK <count> [<ticket> <A|C>]...
+//   STATS                                 OK [<operation> <count> <p50 us> <p99 us> <max us>]...
+//   QUIT                                  (closes the connection)
+// Failures answer "ERR <reason>". Each connection is a Session served by one worker of
+// a fixed pool, so route and fare queries run in parallel. Registrations and logins are
+// applied on the state writer thread, one at a time in arrival order; bookings,
+// cancellations and listings run on the worker against the sharded booking store, and
+// seats are reserved there too since the inventory is safe to share.
+
+// Runs jobs against the user store, and takes snapshots, on one thread
+struct StateWriter {
+    struct Job {
+        const function<void()>* work;
+        bool* done;
+    };
+
+    mutex lock;
+    condition_variable ready;     // wakes the writer
+    condition_variable completed; // wakes requesters waiting for their job
+    deque<Job> jobs;
+    bool stopping;
+    thread writer;
+
+    StateWriter() : stopping(false) {}
+
+    bool isRunning() const { return writer.joinable(); }
+
+    void start() {
+        stopping = false;
+        writer = thread(&StateWriter::writeLoop, this);
+    }
+
+    // Run work on the writer thread and wait for it; runs inline when the writer is not started
+    void run(const function<void()>& work) {
+        if (!isRunning()) {
+            work();
+            return;
+        }
+        bool done = false;
+        Job job = { &work, &done };
+        unique_lock<mutex> guard(lock);
+        jobs.push_back(job);
+        ready.notify_one();
+        while (!done) completed.wait(guard);
+    }
+
+    void writeLoop() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            while (jobs.empty() && !stopping) ready.wait(guard);
+            if (jobs.empty()) break;
+            Job job = jobs.front();
+            jobs.pop_front();
+            guard.unlock();
+            (*job.work)();
+            maybeTakeSnapshot();
+            guard.lock();
+            *job.done = true;
+            completed.notify_all();
+        }
+    }
+
+    void stop() {
+        if (!isRunning()) return;
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+            ready.notify_one();
+        }
+        writer.join();
+    }
+};
+
+StateWriter stateWriter;
+
+// Split a request line on spaces; with maxFields set, the last field keeps the rest of the line
+void splitRequest(const string& line, vector<string>& fields, int maxFields = INT_MAX) {
+    fields.clear();
+    size_t at = 0;
+    while (at < line.size()) {
+        while (at < line.size() && line[at] == ' ') at++;
+        if (at == line.size()) break;
+        size_t end = (int)fields.size() + 1 == maxFields ? line.size() : line.find(' ', at);
+        if (end == string::npos) end = line.size();
+        fields.push_back(line.substr(at, end - at));
+        at = end;
+    }
+}
+
+bool parseNumber(const string& text, int& value) {
+    char* end;
+    errno = 0;
+    long parsed = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || errno != 0 || parsed < INT_MIN || parsed > INT_MAX) return false;
+    value = parsed;
+    return true;
+}
+
+bool parseStation(const string& text, int& station) {
+    return parseNumber(text, station) && station >= 0 && station < stations.size();
+}
+
+bool parseTicketClass(const string& text, TicketClass& ticketClass) {
+    int choice;
+    if (!parseNumber(text, choice) || choice < GENERAL || choice > FIRST_CLASS) return false;
+    ticketClass = (TicketClass)choice;
+    return true;
+}
+
+// Answer one request line into response; returns false when the client asked to quit
+bool handleRequest(Session& session, const string& line, vector<string>& fields, string& response) {
+    splitRequest(line, fields, line.compare(0, 5, "BOOK ") == 0 ? 8 : INT_MAX);
+    if (fields.empty()) {
+        response += "ERR empty request\n";
+        return true;
+    }
+    const string& command = fields[0];
+    int from, to;
+    TicketClass ticketClass;
+
+    if (command == "ROUTE" || command == "FARE") {
+        bool isFare = command == "FARE";
+        if (fields.size() != (isFare ? 4 : 3) || !parseStation(fields[1], from) || !parseStation(fields[2], to) ||
+            (isFare && !parseTicketClass(fields[3], ticketClass))) {
+            response += isFare ? "ERR usage: FARE <from> <to> <class>\n" : "ERR usage: ROUTE <from> <to>\n";
+            return true;
+        }
+        RouteResult route = findRoute(from, to);
+        if (!route.found) {
+            response += "ERR no route\n";
+            return true;
+        }
+        response += "OK " + to_string(route.totalDistance);
+        if (isFare) {
+            TimeInfo timeInfo(route.totalDistance);
+            response += " " + to_string(timeInfo.totalMinutes()) + " " +
+                        to_string(getFareForClass(route.totalDistance, ticketClass));
+        } else {
+            for (int i = 0; i < route.path.size(); i++) response += " " + to_string(route.path[i]);
+        }
+        response += "\n";
+    } else if (command == "ROUTES") {
+        int k;
+        if (fields.size() != 4 || !parseStation(fields[1], from) || !parseStation(fields[2], to) ||
+            !parseNumber(fields[3], k) || k < 1 || k > MAX_ROUTE_ALTERNATIVES) {
+            response += "ERR usage: ROUTES <from> <to> <k> with k from 1 to " + to_string(MAX_ROUTE_ALTERNATIVES) + "\n";
+            return true;
+        }
+        thread_local KShortestSearch search;
+        vector<RouteResult> routes = findKShortestRoutes(from, to, k, getStationGraph(), search);
+        response += "OK " + to_string(routes.size());
+        for (int r = 0; r < routes.size(); r++) {
+            response += " " + to_string(routes[r].totalDistance) + " ";
+            for (int i = 0; i < routes[r].path.size(); i++) {
+                if (i > 0) response += ",";
+                response += to_string(routes[r].path[i]);
+            }
+        }
+        response += "\n";
+    } else if (command == "REGISTER" || command == "LOGIN") {
+        if (fields.size() != 3) {
+            response += "ERR usage: " + command + " <username> <password>\n";
+            return true;
+        }
+        bool registering = command == "REGISTER";
+        int userId = -1;
+        long long journaled = 0;
+        OperationTimer timer(METRIC_LOGIN);
+        stateWriter.run([&]() {
+            userId = registering ? createUser(fields[1], fields[2], &journaled) : authenticateUser(fields[1], fields[2]);
+        });
+        if (!registering) timer.stop();
+        if (userId == -1) {
+            response += registering ? "ERR username taken\n" : "ERR invalid username or password\n";
+            return true;
+        }
+        if (registering) {
+            response += syncJournal(journaled) ? "OK " + to_string(userId) + "\n" : "ERR journal unavailable\n";
+        } else {
+            session.userId = userId;
+            response += "OK\n";
+        }
+    } else if (command == "LOGOUT") {
+        session.userId = -1;
+        response += "OK\n";
+    } else if (command == "BOOK") {
+        int train, age, travelDay = fields.size() == 8 ? parseTravelDay(fields[5]) : -1;
+        if (fields.size() != 8 || !parseStation(fields[1], from) || !parseStation(fields[2], to) || from == to ||
+            max(from, to) >= MAX_BOOKABLE_STATIONS || !parseTicketClass(fields[3], ticketClass) ||
+            !parseNumber(fields[4], train) || train < 1 || train > MAX_TRAIN_NUMBER || travelDay == -1 ||
+            !parseNumber(fields[6], age) || age < 0 || age > MAX_PASSENGER_AGE) {
+            response += "ERR usage: BOOK <from> <to> <class> <train> <YYYY-MM-DD> <age> <passenger name>\n";
+            return true;
+        }
+        if (!session.loggedIn()) {
+            response += "ERR login required\n";
+            return true;
+        }
+        RouteResult route = findRoute(from, to);
+        if (!route.found) {
+            response += "ERR no route\n";
+            return true;
+        }
+        int fare = getPassengerFare(route.totalDistance, ticketClass, age);
+        OperationTimer timer(METRIC_BOOK);
+        int soldOutLeg = seatInventory.reserve(train, travelDay, ticketClass, route.path);
+        if (soldOutLeg != -1) {
+            response += "ERR sold out " + to_string(route.path[soldOutLeg]) + " " +
+                        to_string(route.path[soldOutLeg + 1]) + "\n";
+            return true;
+        }
+        long long journaled = 0;
+        int ticketNumber = recordBooking(session.userId, fields[7], age, from, to, ticketClass,
+                                         route.totalDistance, fare, train, travelDay, route.path, &journaled);
+        // Snapshots are taken on the writer, which checks after every job it runs
+        if (snapshotDue()) stateWriter.run([]() {});
+        if (!syncJournal(journaled)) {
+            response += "ERR journal unavailable\n";
+            return true;
+        }
+        timer.stop();
+        response += "OK " + to_string(ticketNumber) + " " + to_string(fare) + "\n";
+    } else if (command == "CANCEL") {
+        int ticketNumber;
+        if (fields.size() != 2 || !parseNumber(fields[1], ticketNumber)) {
+            response += "ERR usage: CANCEL <ticket>\n";
+            return true;
+        }
+        if (!session.loggedIn()) {
+            response += "ERR login required\n";
+            return true;
+        }
+        OperationTimer timer(METRIC_CANCEL);
+        BookingRecord cancelled;
+        long long journaled = 0;
+        if (!cancelTicket(session.userId, ticketNumber, cancelled, &journaled)) {
+            response += "ERR ticket not found or already cancelled\n";
+            return true;
+        }
+        if (snapshotDue()) stateWriter.run([]() {});
+        if (!syncJournal(journaled)) {
+            response += "ERR journal unavailable\n";
+            return true;
+        }
+        timer.stop();
+        response += "OK " + to_string(cancelled.fare) + "\n";
+    } else if (command == "BOOKINGS") {
+        if (!session.loggedIn()) {
+            response += "ERR login required\n";
+            return true;
+        }
+        vector<BookingRecord> records;
+        getUserBookings(session.userId, records);
+        response += "OK " + to_string(records.size());
+        for (int t = 0; t < records.size(); t++) {
+            response += " " + to_string(records[t].ticketNumber) + (records[t].active ? " A" : " C");
+        }
+        response += "\n";
+    } else if (command == "STATS") {
+        if (!metricsEnabled) {
+            response += "ERR metrics are off\n";
+            return true;
+        }
+        MetricsTotals totals;
+        collectMetrics(totals);
+        response += "OK";
+        for (int op = 0; op < METRIC_OPERATION_COUNT; op++) {
+            response += string(" ") + METRIC_OPERATION_NAMES[op] + " " + to_string(totals.operations[op]) + " " +
+                        to_string((long long)totals.percentileMicros(op, 0.50)) + " " +
+                        to_string((long long)totals.percentileMicros(op, 0.99)) + " " +
+                        to_string(totals.maxNanos[op] / 1000);
+        }
+        response += "\n";
+    } else if (command == "QUIT") {
+        return false;
+    } else {
+        response += "ERR unknown command " + command + "\n";
+    }
+    return true;
+}
+
+// Serve one client until it disconnects or quits. Every complete line in a read is
+// answered before the responses go out in a single write, so pipelined requests batch.
+void serveConnection(int fd) {
+    Session session;
+    string input, response, line;
+    vector<string> fields;
+    char buffer[16384];
+    bool connected = true;
+    while (connected) {
+        ssize_t received = read(fd, buffer, sizeof(buffer));
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) break;
+        input.append(buffer, received);
+
+        size_t lineStart = 0, lineEnd;
+        while (connected && (lineEnd = input.find('\n', lineStart)) != string::npos) {
+            line.assign(input, lineStart, lineEnd - lineStart);
+            if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+            lineStart = lineEnd + 1;
+            connected = handleRequest(session, line, fields, response);
+        }
+        input.erase(0, lineStart);
+        if (!response.empty() && !writeFully(fd, response.data(), response.size())) break;
+        response.clear();
+    }
+    ::close(fd);
+}
+
+// Accepts connections on 127.0.0.1 and hands each to the next free worker
+struct RequestServer {
+    int listenFd;
+    int port;
+    mutex lock;
+    condition_variable connectionReady;
+    deque<int> waiting; // accepted connections not yet picked up by a worker
+    vector<thread> workers;
+    thread acceptor;
+    bool stopping;
+
+    RequestServer() : listenFd(-1), port(0), stopping(false) {}
+
+    // Listen on port (0 picks a free one) with workerCount workers; false if the port is unavailable
+    bool start(int requestedPort, int workerCount) {
+        signal(SIGPIPE, SIG_IGN); // a client hanging up must not kill the server
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(requestedPort);
+        socklen_t length = sizeof(address);
+        if (listenFd == -1 || ::bind(listenFd, (sockaddr*)&address, sizeof(address)) != 0 ||
+            listen(listenFd, 1024) != 0 || getsockname(listenFd, (sockaddr*)&address, &length) != 0) {
+            if (listenFd != -1) ::close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        port = ntohs(address.sin_port);
+        stopping = false;
+        for (int w = 0; w < workerCount; w++) workers.push_back(thread(&RequestServer::workLoop, this));
+        acceptor = thread(&RequestServer::acceptLoop, this);
+        return true;
+    }
+
+    void acceptLoop() {
+        while (true) {
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                break; // listening socket shut down
+            }
+            int noDelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            lock_guard<mutex> guard(lock);
+            waiting.push_back(fd);
+            connectionReady.notify_one();
+        }
+    }
+
+    void workLoop() {
+        while (true) {
+            int fd;
+            {
+                unique_lock<mutex> guard(lock);
+                while (waiting.empty() && !stopping) connectionReady.wait(guard);
+                if (waiting.empty()) return;
+                fd = waiting.front();
+                waiting.pop_front();
+            }
+            serveConnection(fd);
+        }
+    }
+
+    // Stop accepting and wait for the workers; connections still open are served to the end
+    void stop() {
+        if (listenFd == -1) return;
+        shutdown(listenFd, SHUT_RDWR);
+        acceptor.join();
+        ::close(listenFd);
+        listenFd = -1;
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+            connectionReady.notify_all();
+        }
+        for (int w = 0; w < workers.size(); w++) workers[w].join();
+        workers.clear();
+    }
+};
+
+// Batch Quoting
+//
+// --batch reads origin/destination pairs from a CSV/TSV file (or stdin) and writes one
+// quote per pair and class, without the menu. Input lines are
+//   <from>,<to>[,<class>]
+// where stations are indices or names, <to> may be * for every other station, and a
+// missing class quotes all four. Output rows follow the input order:
+//   CSV:    from,to,class,distance_km,travel_minutes,fare   (-1 when unreachable)
+//   binary: BatchFileHeader, then one BatchQuote per row
+// Queries are grouped by source and each source is answered by one shortest-path tree
+// (or the all-pairs matrix), spread over worker threads.
+
+const uint32_t BATCH_MAGIC = 0x54515752; // "RWQT"
+const uint32_t BATCH_FORMAT_VERSION = 1;
+
+struct BatchFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t quoteCount;
+};
+
+struct BatchQuote {
+    int32_t from;
+    int32_t to;
+    int32_t ticketClass;
+    int32_t distance;
+    int32_t minutes;
+    int32_t fare;
+};
+
+struct BatchQuery {
+    int from;
+    int to;
+    int ticketClass; // 0 quotes every class
+};
+
+
+// Station index for an input field: a number in range, or an exact station name
+int resolveStation(const string& field, const unordered_map<string, int>& stationByName) {
+    int station;
+    if (parseStation(field, station)) return station;
+    unordered_map<string, int>::const_iterator it = stationByName.find(field);
+    return it == stationByName.end() ? -1 : it->second;
+}
+
+bool readBatchQueries(const string& path, vector<BatchQuery>& queries) {
+    string text;
+    if (path == "-") {
+        text.assign(istreambuf_iterator<char>(cin), istreambuf_iterator<char>());
+    } else {
+        ifstream in(path.c_str(), ios::binary);
+        if (!in) {
+            cerr << "Cannot open batch file " << path << "\n";
+            return false;
+        }
+        text.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+
+    unordered_map<string, int> stationByName;
+    for (int i = 0; i < stations.size(); i++) stationByName[stations[i].name] = i;
+    vector<string> fields;
+    int lineNumber = 0;
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == string::npos) lineEnd = text.size();
+        lineNumber++;
+        splitNetworkLine(text.data() + lineStart, text.data() + lineEnd, fields);
+        lineStart = lineEnd + 1;
+        if (fields[0].empty() || fields[0][0] == '#') continue;
+
+        BatchQuery query;
+        TicketClass ticketClass = GENERAL;
+        bool allDestinations = fields.size() >= 2 && fields[1] == "*";
+        query.from = resolveStation(fields[0], stationByName);
+        query.to = fields.size() >= 2 && !allDestinations ? resolveStation(fields[1], stationByName) : -1;
+        query.ticketClass = fields.size() == 3 && parseTicketClass(fields[2], ticketClass) ? ticketClass : 0;
+        if (fields.size() < 2 || fields.size() > 3 || query.from == -1 || (query.to == -1 && !allDestinations) ||
+            (fields.size() == 3 && query.ticketClass == 0)) {
+            cerr << path << ":" << lineNumber << ": expected from,to[,class] with known stations and class 1-4\n";
+            return false;
+        }
+        if (!allDestinations) {
+            queries.push_back(query);
+            continue;
+        }
+        for (int to = 0; to < stations.size(); to++) {
+            if (to == query.from) continue;
+            query.to = to;
+            queries.push_back(query);
+        }
+    }
+    return true;
+}
+
+// Fill distance[i] for every query, one source at a time on each worker
+void computeBatchDistances(const vector<BatchQuery>& queries, vector<int>& distance, int workerCount) {
+    int n = stations.size();
+    // Counting sort of query positions by source
+    vector<int> sourceStart(n + 1, 0), bySource(queries.size());
+    for (size_t i = 0; i < queries.size(); i++) sourceStart[queries[i].from + 1]++;
+    for (int s = 0; s < n; s++) sourceStart[s + 1] += sourceStart[s];
+    vector<int> fill(sourceStart.begin(), sourceStart.end() - 1);
+    for (size_t i = 0; i < queries.size(); i++) bySource[fill[queries[i].from]++] = i;
+
+    distance.assign(queries.size(), -1);
+    const StationGraph& graph = getStationGraph();
+    const DistanceMatrix* matrix = getDistanceMatrix();
+    atomic<int> nextSource(0);
+    vector<thread> workers;
+    for (int w = 0; w < workerCount; w++) {
+        workers.push_back(thread([&]() {
+            ShortestPathTree tree;
+            for (int source = nextSource++; source < n; source = nextSource++) {
+                if (sourceStart[source] == sourceStart[source + 1]) continue;
+                if (matrix == NULL) computeShortestPathTree(graph, source, tree);
+                for (int k = sourceStart[source]; k < sourceStart[source + 1]; k++) {
+                    int to = queries[bySource[k]].to;
+                    long long d = matrix != NULL ? (long long)matrix->distance[(size_t)source * n + to] : tree.dist[to];
+                    bool reachable = matrix != NULL ? d != UNREACHABLE_DISTANCE : d != INT_MAX;
+                    distance[bySource[k]] = reachable ? (int)d : -1;
+                }
+            }
+        }));
+    }
+    for (int w = 0; w < workers.size(); w++) workers[w].join();
+}
+
+void writeBatchQuote(OutputBuffer& out, bool binary, int from, int to, int ticketClass, int distance, int fare) {
+    int minutes = distance < 0 ? -1 : TimeInfo(distance).totalMinutes();
+    if (binary) {
+        BatchQuote quote = { from, to, ticketClass, distance, minutes, fare };
+        out.append((const char*)&quote, sizeof(quote));
+        return;
+    }
+    out.appendInt(from);
+    out.appendChar(',');
+    out.appendInt(to);
+    out.appendChar(',');
+    out.appendInt(ticketClass);
+    out.appendChar(',');
+    out.appendInt(distance);
+    out.appendChar(',');
+    out.appendInt(minutes);
+    out.appendChar(',');
+    out.appendInt(fare);
+    out.appendChar('\n');
+}
+
+// Quote every pair in inputPath into outputPath ("-" for stdout); returns false on any I/O or input error
+bool runBatch(const string& inputPath, const string& outputPath, bool binary, int workerCount) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<BatchQuery> queries;
+    if (!readBatchQueries(inputPath, queries)) return false;
+    vector<int> distance;
+    computeBatchDistances(queries, distance, workerCount);
+    double searchMs = elapsedMs(start);
+    FareColumns fares;
+    priceDistances(tariff, distance.data(), distance.size(), fares);
+
+    int fd = outputPath == "-" ? STDOUT_FILENO : ::open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        cerr << "Cannot open batch output " << outputPath << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    uint64_t rowCount = 0;
+    for (size_t i = 0; i < queries.size(); i++) rowCount += queries[i].ticketClass == 0 ? 4 : 1;
+    OutputBuffer out(fd);
+    if (binary) {
+        BatchFileHeader header = { BATCH_MAGIC, BATCH_FORMAT_VERSION, rowCount };
+        out.append((const char*)&header, sizeof(header));
+    } else {
+        const char* columns = "from,to,class,distance_km,travel_minutes,fare\n";
+        out.append(columns, strlen(columns));
+    }
+    for (size_t i = 0; i < queries.size(); i++) {
+        const BatchQuery& query = queries[i];
+        int firstClass = query.ticketClass == 0 ? GENERAL : query.ticketClass;
+        int lastClass = query.ticketClass == 0 ? FIRST_CLASS : query.ticketClass;
+        for (int c = firstClass; c <= lastClass; c++) {
+            writeBatchQuote(out, binary, query.from, query.to, c, distance[i], fares.byClass[c][i]);
+        }
+    }
+    bool ok = out.flush();
+    if (fd != STDOUT_FILENO) ok = ::close(fd) == 0 && ok;
+    if (!ok) {
+        cerr << "Could not write batch output " << outputPath << "\n";
+        return false;
+    }
+    double totalMs = elapsedMs(start);
+    cerr << "Quoted " << rowCount << " rows for " << queries.size() << " pairs in " << fixed << setprecision(1)
+         << totalMs << " ms (" << searchMs << " ms routing, "
+         << setprecision(0) << rowCount / max(totalMs, 0.001) * 60000 << " quotes per minute)\n";
+    return true;
+}
+
+// Benchmark Functions
+
+// Replace the network with a jittered grid of stations spread over India, roughly
+// 2.3 track segments per station like the real network; used by the benchmarks
+void generateSyntheticNetwork(int stationCount, unsigned int seed) {
+    mt19937 rng(seed);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    int columns = max(1, (int)ceil(sqrt((double)stationCount)));
+    int rows = (stationCount + columns - 1) / columns;
+    double latitudeStep = 27.0 / rows, longitudeStep = 29.0 / columns;
+
+    stations.clear();
+    segmentIds.clear();
+    stations.resize(stationCount);
+    for (int i = 0; i < stationCount; i++) {
+        stations[i].name = "Station " + to_string(i);
+        stations[i].latitude = 8.0 + (i / columns + 0.2 + 0.6 * unit(rng)) * latitudeStep;
+        stations[i].longitude = 68.0 + (i % columns + 0.2 + 0.6 * unit(rng)) * longitudeStep;
+        stations[i].hasCoordinates = true;
+    }
+    graphVersion++;
+
+    const double DEG_TO_RAD = M_PI / 180.0;
+    for (int i = 0; i < stationCount; i++) {
+        int column = i % columns;
+        int targets[3] = { column + 1 < columns ? i + 1 : -1, i + columns,
+                           column + 1 < columns && unit(rng) < 0.3 ? i + columns + 1 : -1 };
+        for (int t = 0; t < 3; t++) {
+            int j = targets[t];
+            if (j < 0 || j >= stationCount) continue;
+            double straight = greatCircleKm(stations[i].latitude * DEG_TO_RAD, stations[i].longitude * DEG_TO_RAD,
+                                            stations[j].latitude * DEG_TO_RAD, stations[j].longitude * DEG_TO_RAD);
+            addConnection(i, j, max(1, (int)ceil(straight * (1.05 + 0.3 * unit(rng)))));
+        }
+    }
+}
+
+// Replace the timetable with about connectionTarget connections on the synthetic network:
+// 600 lines that each wander 20-60 stops in one general direction, run many times
+// a day at random departure times. Trains average 50-110 km/h and dwell two minutes.
+void generateSyntheticTimetable(int connectionTarget, unsigned int seed) {
+    mt19937 rng(seed);
+    const StationGraph& graph = getStationGraph();
+    vector<vector<int> > lineStops, lineMinutes; // stop stations and running minutes to each stop
+    Timetable generated;
+    while (lineStops.size() < 600) {
+        vector<int> stops(1, rng() % graph.stationCount), minutes(1, 0);
+        int stopCount = 20 + rng() % 41, speed = 50 + rng() % 61;
+        bool ascending = rng() % 2;
+        while (stops.size() < stopCount) {
+            int u = stops.back(), candidates = 0, chosen = -1;
+            for (int j = graph.offsets[u]; j < graph.offsets[u + 1]; j++) {
+                if ((graph.neighbors[j] > u) == ascending && rng() % ++candidates == 0) chosen = j;
+            }
+            if (chosen == -1) break;
+            stops.push_back(graph.neighbors[chosen]);
+            minutes.push_back(minutes.back() + 2 + graph.weights[chosen] * 60 / speed);
+        }
+        if (stops.size() < 2) continue;
+        lineStops.push_back(stops);
+        lineMinutes.push_back(minutes);
+    }
+
+    for (int line = 0; generated.connections.size() < connectionTarget; line = (line + 1) % lineStops.size()) {
+        const vector<int>& stops = lineStops[line];
+        const vector<int>& minutes = lineMinutes[line];
+        int start = rng() % MINUTES_PER_DAY, trip = generated.tripTrain.size();
+        generated.tripTrain.push_back(10000 + line);
+        generated.tripStopStart.push_back(generated.tripStops.size());
+        generated.tripStops.insert(generated.tripStops.end(), stops.begin(), stops.end());
+        for (int i = 0; i + 1 < stops.size(); i++) {
+            TimetableConnection connection = { start + minutes[i] + (i > 0 ? 2 : 0), start + minutes[i + 1],
+                                               stops[i], stops[i + 1], trip };
+            generated.connections.push_back(connection);
+        }
+    }
+    finishTimetable(generated);
+    swap(timetable, generated);
+}
+
+// Earliest-arrival queries over a synthetic national-scale timetable
+void benchmarkTimetable(int connectionCount, int queryCount) {
+    generateSyntheticNetwork(10000, 42);
+    freezeStationGraph();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    generateSyntheticTimetable(connectionCount, 5);
+    double buildMs = elapsedMs(start);
+
+    mt19937 rng(9);
+    TimetableSearch search;
+    vector<double> latencies;
+    long long scanned = 0;
+    int found = 0, rides = 0;
+    for (int q = 0; q < queryCount; q++) {
+        int source = timetable.connections[rng() % timetable.connections.size()].from;
+        int destination = timetable.connections[rng() % timetable.connections.size()].to;
+        int departure = rng() % MINUTES_PER_DAY;
+        chrono::steady_clock::time_point queryStart = chrono::steady_clock::now();
+        TimetableJourney journey = findEarliestArrival(timetable, source, destination, departure, search);
+        latencies.push_back(elapsedMs(queryStart));
+        scanned += journey.scannedConnections;
+        if (journey.found) {
+            found++;
+            rides += journey.rides.size();
+        }
+    }
+    sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (int q = 0; q < queryCount; q++) total += latencies[q];
+
+    cout << "\n=== Timetable Benchmark ===\n";
+    cout << "Stations: " << stations.size() << ", trips: " << timetable.tripTrain.size() << ", connections: "
+         << timetable.connections.size() << ", scan array: " << timetable.scan.size() << " (built in " << fixed
+         << setprecision(1) << buildMs << " ms)\n";
+    cout << "Queries: " << queryCount << ", journeys found: " << found << ", average rides: " << setprecision(2)
+         << (found > 0 ? (double)rides / found : 0.0) << ", connections scanned/query: " << scanned / queryCount << "\n";
+    cout << setprecision(3) << "Earliest arrival: mean " << total / queryCount << " ms, p50 "
+         << latencies[queryCount / 2] << " ms, p99 " << latencies[queryCount * 99 / 100] << " ms\n";
+}
+
+// Pareto route queries on a synthetic network: time, size of the Pareto set and labels created.
+// The queries are then rerun with a label limit below the median search size: searches
+// that hit it must say so, and those that did not must return the same routes as before.
+bool benchmarkParetoRoutes(int stationCount, int queryCount) {
+    generateSyntheticNetwork(stationCount, 42);
+    freezeStationGraph();
+    const StationGraph& graph = getStationGraph();
+    mt19937 rng(13);
+    ParetoSearch search;
+    vector<pair<int, int> > queries;
+    vector<vector<int> > distances(queryCount); // Pareto set of each query, as route lengths
+    vector<long long> labels;
+    long long routeCount = 0, labelCount = 0;
+    int truncatedCount = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int q = 0; q < queryCount; q++) {
+        int source = rng() % stationCount, destination = rng() % stationCount;
+        vector<RouteResult> routes = findParetoRoutes(source, destination, SLEEPER, graph, search);
+        queries.push_back(make_pair(source, destination));
+        for (int i = 0; i < routes.size(); i++) distances[q].push_back(routes[i].totalDistance);
+        routeCount += routes.size();
+        labelCount += search.labels.size();
+        labels.push_back(search.labels.size());
+        if (search.truncated) truncatedCount++;
+    }
+    double elapsed = elapsedMs(start);
+
+    cout << "\n=== Pareto Route Benchmark ===\n";
+    cout << "Stations: " << stationCount << ", queries: " << queryCount << "\n";
+    cout << fixed << setprecision(3) << "Query time: " << elapsed / queryCount << " ms, routes in Pareto set: "
+         << setprecision(1) << (double)routeCount / queryCount << ", labels/query: " << labelCount / queryCount
+         << ", truncated: " << truncatedCount << "\n";
+
+    sort(labels.begin(), labels.end());
+    search.labelLimit = max(2LL, labels[labels.size() / 2] / 2);
+    int limitedCount = 0, changed = 0;
+    for (int q = 0; q < queryCount; q++) {
+        vector<RouteResult> routes = findParetoRoutes(queries[q].first, queries[q].second, SLEEPER, graph, search);
+        vector<int> found;
+        for (int i = 0; i < routes.size(); i++) found.push_back(routes[i].totalDistance);
+        if (search.truncated) limitedCount++;
+        else if (found != distances[q]) changed++;
+    }
+    bool ok = changed == 0 && limitedCount > 0;
+    cout << "With a limit of " << search.labelLimit << " labels: " << limitedCount
+         << " queries truncated, " << changed << " answers not flagged as truncated but different\n";
+    cout << (ok ? "PASS" : "FAIL") << "\n";
+    return ok;
+}
+
+// k shortest routes on a synthetic network, with the workspace reused across queries
+void benchmarkKShortestRoutes(int stationCount, int k, int queryCount) {
+    generateSyntheticNetwork(stationCount, 42);
+    freezeStationGraph();
+    const StationGraph& graph = getStationGraph();
+    mt19937 rng(17);
+    KShortestSearch search;
+    vector<double> latencies;
+    long long routeCount = 0;
+    for (int q = 0; q < queryCount; q++) {
+        int source = rng() % stationCount, destination = rng() % stationCount;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        routeCount += findKShortestRoutes(source, destination, k, graph, search).size();
+        latencies.push_back(elapsedMs(start));
+    }
+    sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (int q = 0; q < queryCount; q++) total += latencies[q];
+
+    cout << "\n=== K Shortest Routes Benchmark ===\n";
+    cout << "Stations: " << stationCount << ", k: " << k << ", queries: " << queryCount << ", routes/query: "
+         << fixed << setprecision(1) << (double)routeCount / queryCount << "\n";
+    cout << setprecision(2) << "Query time: mean " << total / queryCount << " ms, p50 " << latencies[queryCount / 2]
+         << " ms, p99 " << latencies[queryCount * 99 / 100] << " ms\n";
+}
+
+// Random closures, reopenings and re-measurements on a synthetic network with the
+// all-pairs matrix enabled: time each repair against a full rebuild and check the
+// repaired matrix against a rebuilt one every few changes. Returns false on any mismatch.
+bool benchmarkTrackClosures(int stationCount, int changeCount) {
+    generateSyntheticNetwork(stationCount, 42);
+    freezeStationGraph();
+    useDistanceMatrix = true;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    getDistanceMatrix();
+    double rebuildMs = elapsedMs(start);
+
+    mt19937 rng(23);
+    vector<pair<int, int> > closed;
+    vector<double> latencies;
+    int mismatches = 0;
+    DistanceMatrix reference;
+    for (int c = 0; c < changeCount; c++) {
+        int a = rng() % stationCount;
+        while (stations[a].connections.empty()) a = rng() % stationCount;
+        int b = stations[a].connections[rng() % stations[a].connections.size()].first;
+        start = chrono::steady_clock::now();
+        if (!closed.empty() && rng() % 3 == 0) {
+            int i = rng() % closed.size();
+            reopenConnection(closed[i].first, closed[i].second);
+            closed.erase(closed.begin() + i);
+        } else if (rng() % 2 == 0) {
+            closeConnection(a, b);
+            closed.push_back(make_pair(a, b));
+        } else {
+            setConnectionDistance(a, b, max(1, (int)(getConnectionDistance(a, b) * (0.7 + (rng() % 61) / 100.0))));
+        }
+        latencies.push_back(elapsedMs(start));
+
+        if ((c + 1) % 25 != 0 && c + 1 != changeCount) continue;
+        buildDistanceMatrix(getStationGraph(), reference);
+        const StationGraph& graph = getStationGraph();
+        size_t n = stationCount;
+        for (size_t s = 0; s < n; s++) {
+            for (size_t t = 0; t < n; t++) {
+                size_t cell = s * n + t;
+                uint32_t d = distanceMatrix.distance[cell];
+                bool ok = d == reference.distance[cell];
+                // The first hop must be a neighbour that is exactly one leg closer
+                if (ok && d != UNREACHABLE_DISTANCE && s != t) {
+                    int hop = distanceMatrix.nextHop[cell];
+                    int leg = -1;
+                    for (int j = graph.offsets[s]; j < graph.offsets[s + 1]; j++) {
+                        if (graph.neighbors[j] == hop && (leg == -1 || graph.weights[j] < leg)) leg = graph.weights[j];
+                    }
+                    ok = leg != -1 && d == leg + distanceMatrix.distance[hop * n + t];
+                }
+                if (!ok) mismatches++;
+            }
+        }
+    }
+    sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (int c = 0; c < changeCount; c++) total += latencies[c];
+
+    cout << "\n=== Track Closure Benchmark ===\n";
+    cout << "Stations: " << stationCount << ", changes: " << changeCount << "\n";
+    cout << fixed << setprecision(2) << "Full matrix rebuild: " << rebuildMs << " ms\n";
+    cout << "Repair per change: mean " << total / changeCount << " ms, p50 " << latencies[changeCount / 2]
+         << " ms, p99 " << latencies[changeCount * 99 / 100] << " ms\n";
+    cout << (mismatches == 0 ? "PASS" : "FAIL") << ": " << mismatches << " matrix entries differ from a rebuild\n";
+    return mismatches == 0;
+}
+
+// dijkstra() on every engine with the route cache off: after a warm-up pass over one set
+// of queries, a second set should allocate nothing, since every search runs in the
+// thread's workspace and the path goes into a vector the caller keeps
+void benchmarkSearchAllocations(int stationCount, int queryCount) {
+    generateSyntheticNetwork(stationCount, 42);
+    freezeStationGraph();
+    const StationGraph& graph = getStationGraph();
+    setRouteCacheCapacity(0);
+    getContractionHierarchy();
+
+    mt19937 rng(11);
+    vector<pair<int, int> > queries(3 * queryCount);
+    for (int i = 0; i < queries.size(); i++) {
+        queries[i] = make_pair((int)(rng() % stationCount), (int)(rng() % stationCount));
+    }
+
+    cout << "\n=== Search Allocation Benchmark ===\n";
+    cout << "Stations: " << stationCount << ", queries: " << queryCount << " (after " << 2 * queryCount
+         << " warm-up queries)\n";
+    RouteEngine engines[3] = { ENGINE_DIJKSTRA, ENGINE_BIDIRECTIONAL_ASTAR, ENGINE_CONTRACTION_HIERARCHY };
+    const char* names[3] = { "Dijkstra", "A*", "CH" };
+    vector<int> path;
+    for (int e = 0; e < 3; e++) {
+        routeEngine = engines[e];
+        for (int i = 0; i < 2 * queryCount; i++) dijkstra(queries[i].first, queries[i].second, graph, path);
+
+        unsigned long long allocationsBefore = threadAllocations;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int i = 2 * queryCount; i < queries.size(); i++) {
+            dijkstra(queries[i].first, queries[i].second, graph, path);
+        }
+        double reusedMs = elapsedMs(start);
+        unsigned long long reusedAllocations = threadAllocations - allocationsBefore;
+
+        // The same queries through the by-value overload, which returns a fresh path each time
+        allocationsBefore = threadAllocations;
+        start = chrono::steady_clock::now();
+        for (int i = 2 * queryCount; i < queries.size(); i++) {
+            path = dijkstra(queries[i].first, queries[i].second, graph);
+        }
+        double returnedMs = elapsedMs(start);
+        unsigned long long returnedAllocations = threadAllocations - allocationsBefore;
+
+        cout << fixed << setprecision(3) << setw(9) << names[e] << ": " << reusedMs * 1000 / queryCount
+             << " us/query";
+        if (countingAllocations) cout << ", " << (double)reusedAllocations / queryCount << " allocations/query";
+        cout << "; returning the path: " << returnedMs * 1000 / queryCount << " us/query";
+        if (countingAllocations) cout << ", " << (double)returnedAllocations / queryCount << " allocations/query";
+        cout << "\n";
+    }
+    if (!countingAllocations) cout << "Allocations are not counted; build with -DRAILWAY_COUNT_ALLOCATIONS to count them\n";
+}
+
+// Price distanceCount random distances in every class with the current tariff, one
+// call per quote and then in one batch, and check that both agree
+bool benchmarkFares(int distanceCount) {
+    mt19937 rng(5);
+    vector<int> distance(distanceCount);
+    for (int i = 0; i < distanceCount; i++) distance[i] = 1 + rng() % 3000;
+
+    // Both outputs are sized up front so only the pricing is timed
+    FareColumns scalar, batch;
+    for (int c = GENERAL; c <= FIRST_CLASS; c++) {
+        scalar.byClass[c].assign(distanceCount, 0);
+        batch.byClass[c].assign(distanceCount, 0);
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int c = GENERAL; c <= FIRST_CLASS; c++) {
+        for (int i = 0; i < distanceCount; i++) scalar.byClass[c][i] = getFareForClass(distance[i], (TicketClass)c);
+    }
+    double scalarMs = elapsedMs(start);
+
+    start = chrono::steady_clock::now();
+    priceDistances(tariff, distance.data(), distance.size(), batch);
+    double batchMs = elapsedMs(start);
+
+    int mismatches = 0;
+    for (int c = GENERAL; c <= FIRST_CLASS; c++) {
+        for (int i = 0; i < distanceCount; i++) mismatches += scalar.byClass[c][i] != batch.byClass[c][i];
+    }
+    double quotes = 4.0 * distanceCount;
+    cout << "\n=== Fare Benchmark ===\n";
+    cout << "Distances: " << distanceCount << " (" << (long long)quotes << " quotes)\n";
+    cout << fixed << setprecision(1) << "Per quote: " << scalarMs << " ms (" << quotes / scalarMs / 1000
+         << " M quotes/s)\n";
+    cout << "Batch:     " << batchMs << " ms (" << quotes / batchMs / 1000 << " M quotes/s)\n";
+    cout << (mismatches == 0 ? "PASS" : "FAIL") << ": " << mismatches << " fares differ\n";
+    return mismatches == 0;
+}
+
+// Compare Contraction Hierarchy queries with plain dijkstra() on a synthetic network
+void benchmarkContractionHierarchy(int stationCount, int queryCount) {
+    generateSyntheticNetwork(stationCount, 42);
+    freezeStationGraph();
+    const StationGraph& graph = getStationGraph();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    const ContractionHierarchy& ch = getContractionHierarchy();
+    double buildMs = elapsedMs(start);
+
+    mt19937 rng(7);
+    vector<pair<int, int> > queries(queryCount);
+    for (int i = 0; i < queryCount; i++) {
+        queries[i] = make_pair((int)(rng() % stationCount), (int)(rng() % stationCount));
+    }
+
+    vector<int> expected(queryCount);
+    long long dijkstraSettled = 0, chSettled = 0;
+    RouteResult route;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < queryCount; i++) {
+        findRouteDijkstra(queries[i].first, queries[i].second, graph, route);
+        expected[i] = route.totalDistance;
+        dijkstraSettled += route.settledNodes;
+    }
+    double dijkstraMs = elapsedMs(start);
+
+    int mismatches = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < queryCount; i++) {
+        findRouteContractionHierarchy(queries[i].first, queries[i].second, ch, route);
+        if (route.totalDistance != expected[i]) mismatches++;
+        chSettled += route.settledNodes;
     }
-    
-    cout << "Invalid username or password!\n";
-    return false;
-}
+    double chMs = elapsedMs(start);
 
-void logoutUser() {
-    currentUser = "";
-    cout << "Logged out successfully!\n";
+    cout << "\n=== Contraction Hierarchy Benchmark ===\n";
+    cout << "Stations: " << stationCount << ", track segments: " << graph.neighbors.size() / 2
+         << ", queries: " << queryCount << "\n";
+    cout << "Preprocessing: " << fixed << setprecision(1) << buildMs << " ms, "
+         << ch.edges.size() - graph.neighbors.size() / 2 << " shortcuts\n";
+    cout << setprecision(3);
+    cout << "dijkstra(): " << dijkstraMs * 1000 / queryCount << " us/query, "
+         << dijkstraSettled / queryCount << " settled/query\n";
+    cout << "CH query:   " << chMs * 1000 / queryCount << " us/query, "
+         << chSettled / queryCount << " settled/query\n";
+    cout << "Speedup: " << setprecision(1) << dijkstraMs / chMs << "x, distance mismatches: " << mismatches << "\n";
 }
 
-// Optimized Dijkstra with Priority Queue
-vector<int> dijkstra(int source, int destination, const vector<Station>& stations) {
-    int n = stations.size();
-    vector<int> dist(n, INT_MAX);
-    vector<int> prev(n, -1);
+// The O(V^2) array-scan Dijkstra the single-source listings used before, kept as a baseline
+void arrayScanShortestPaths(const StationGraph& graph, int src, vector<int>& dist) {
+    int n = graph.stationCount;
     vector<bool> visited(n, false);
-    priority_queue<pair<int, int>, vector<pair<int, int> >, greater<pair<int, int> > > pq; // (dist, node)
-
-    dist[source] = 0;
-    pq.push(make_pair(0, source));
-
-    while (!pq.empty()) {
-        int u = pq.top().second;
-        pq.pop();
+    dist.assign(n, INT_MAX);
+    dist[src] = 0;
 
-        if (visited[u]) continue;
+    for (int count = 0; count < n; count++) {
+        int minDist = INT_MAX, u = -1;
+        for (int i = 0; i < n; i++) {
+            if (!visited[i] && dist[i] < minDist) {
+                minDist = dist[i];
+                u = i;
+            }
+        }
+        if (u == -1) break;
         visited[u] = true;
 
-        for (int j = 0; j < stations[u].connections.size(); j++) {
-            pair<int, int> edge = stations[u].connections[j];
-            int v = edge.first;
-            int weight = edge.second;
-
-            if (!visited[v] && dist[u] + weight < dist[v]) {
-                dist[v] = dist[u] + weight;
-                prev[v] = u;
-                pq.push(make_pair(dist[v], v));
+        for (int i = graph.offsets[u]; i < graph.offsets[u + 1]; i++) {
+            int v = graph.neighbors[i];
+            if (!visited[v] && dist[u] + graph.weights[i] < dist[v]) {
+                dist[v] = dist[u] + graph.weights[i];
             }
         }
     }
+}
 
-    // Reconstruct path from source to destination
-    vector<int> path;
-    for (int at = destination; at != -1; at = prev[at])
-        path.push_back(at);
+// Scaling curve of the heap-based single-source engine against the array scan
+void benchmarkSingleSource() {
+    const int sizes[] = { 10, 100, 1000, 10000, 100000 };
+    cout << "\n=== Single-Source Shortest Path Benchmark ===\n";
+    cout << setw(10) << "Stations" << setw(16) << "Heap us/tree" << setw(20) << "Array scan us/tree"
+         << setw(10) << "Speedup" << "\n";
 
-    reverse(path.begin(), path.end());
-    return path;
-}
+    for (int s = 0; s < 5; s++) {
+        int n = sizes[s];
+        generateSyntheticNetwork(n, 42);
+        freezeStationGraph();
+        const StationGraph& graph = getStationGraph();
+        mt19937 rng(7);
 
-// Booking System Functions
-int getFareForClass(int distance, TicketClass ticketClass) {
-    FareInfo fareInfo(distance);
-    switch(ticketClass) {
-        case GENERAL: return fareInfo.generalFare;
-        case SLEEPER: return fareInfo.sleeperFare;
-        case AC: return fareInfo.acFare;
-        case FIRST_CLASS: return fareInfo.firstClassFare;
-        default: return fareInfo.generalFare;
-    }
-}
+        int heapRuns = max(5, min(2000, 2000000 / n));
+        ShortestPathTree tree;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int r = 0; r < heapRuns; r++) {
+            computeShortestPathTree(graph, rng() % n, tree);
+        }
+        double heapUs = elapsedMs(start) * 1000 / heapRuns;
 
-string getClassString(TicketClass ticketClass) {
-    switch(ticketClass) {
-        case GENERAL: return "General";
-        case SLEEPER: return "Sleeper";
-        case AC: return "AC";
-        case FIRST_CLASS: return "First Class";
-        default: return "General";
+        cout << setw(10) << n << setw(16) << fixed << setprecision(2) << heapUs;
+        if (n <= 10000) {
+            // Same sources again; the array scan is quadratic, so fewer runs at the top end
+            int scanRuns = max(3, min(heapRuns, 100000000 / (n * n)));
+            rng.seed(7);
+            vector<int> dist;
+            start = chrono::steady_clock::now();
+            for (int r = 0; r < scanRuns; r++) {
+                int source = rng() % n;
+                arrayScanShortestPaths(graph, source, dist);
+            }
+            double scanUs = elapsedMs(start) * 1000 / scanRuns;
+            cout << setw(20) << scanUs << setw(9) << setprecision(1) << scanUs / heapUs << "x";
+        } else {
+            cout << setw(20) << "(skipped)" << setw(10) << "-";
+        }
+        cout << "\n";
     }
 }
 
-// Function to display route path as string
-string getRoutePathString(const vector<int>& path) {
-    string routeStr = "";
-    for (int i = 0; i < path.size(); i++) {
-        routeStr += stations[path[i]].name;
-        if (i < path.size() - 1) routeStr += " -> ";
-    }
-    return routeStr;
-}
+// Time loading a synthetic network of stationCount stations and ~5 edges each
+// from CSV text and from the compiled .rnet file
+void benchmarkNetworkLoading(int stationCount) {
+    generateSyntheticNetwork(stationCount, 42);
+    mt19937 rng(11);
+    string csvPath = "/tmp/railway_bench_network.csv";
+    string binaryPath = "/tmp/railway_bench_network.rnet";
 
-// Helper function to get shortest distance between two stations
-int getShortestDistance(int from, int to) {
-    vector<int> path = dijkstra(from, to, stations);
-    if (path.size() <= 1) return -1; // No path available
-    
-    int distance = 0;
-    for (int i = 0; i < path.size() - 1; i++) {
-        for (int j = 0; j < stations[path[i]].connections.size(); j++) {
-            pair<int, int> conn = stations[path[i]].connections[j];
-            if (conn.first == path[i + 1]) {
-                distance += conn.second;
-                break;
+    int edgeCount = 0;
+    {
+        ofstream out(csvPath.c_str());
+        out << "# synthetic benchmark network\n" << setprecision(9);
+        for (int i = 0; i < stations.size(); i++) {
+            out << "S," << stations[i].name << "," << stations[i].latitude << "," << stations[i].longitude << "\n";
+        }
+        for (int u = 0; u < stations.size(); u++) {
+            for (int j = 0; j < stations[u].connections.size(); j++) {
+                if (stations[u].connections[j].first < u) continue;
+                out << "E," << stations[u].name << "," << stations[stations[u].connections[j].first].name << ","
+                    << stations[u].connections[j].second << "\n";
+                edgeCount++;
             }
         }
+        // Pad with longer nearby links up to five edges per station
+        int span = max(2, (int)sqrt((double)stationCount));
+        for (; edgeCount < 5 * stationCount && stationCount > 1; edgeCount++) {
+            int u = rng() % stationCount;
+            int v = (u + 1 + rng() % (2 * span)) % stationCount;
+            out << "E," << stations[u].name << "," << stations[v].name << "," << 2000 + rng() % 1000 << "\n";
+        }
     }
-    return distance;
-}
 
-void bookTicket() {
-    if (currentUser == "") {
-        cout << "Please login first to book a ticket!\n";
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool ok = loadNetwork(csvPath);
+    getStationGraph();
+    double textMs = elapsedMs(start);
+    ok = ok && saveNetworkBinary(binaryPath);
+
+    start = chrono::steady_clock::now();
+    ok = ok && loadNetwork(binaryPath);
+    getStationGraph();
+    double binaryMs = elapsedMs(start);
+    if (!ok) {
+        cout << "Network load benchmark failed\n";
         return;
     }
-    
-    cout << "\n=== Ticket Booking ===\n";
-    
-    // Get passenger details
-    string passengerName;
-    int age;
-    cout << "Enter passenger name: ";
-    cin.ignore();
-    getline(cin, passengerName);
-    cout << "Enter passenger age: ";
-    cin >> age;
-    
-    // Select stations
-    displayStations();
-    int fromStation, toStation;
-    cout << "Enter source station index: ";
-    cin >> fromStation;
-    cout << "Enter destination station index: ";
-    cin >> toStation;
-    
-    if (fromStation < 0 || fromStation >= stations.size() || 
-        toStation < 0 || toStation >= stations.size() || 
-        fromStation == toStation) {
-        cout << "Invalid station selection!\n";
-        return;
+
+    cout << "\n=== Network Load Benchmark ===\n";
+    cout << "Stations: " << stations.size() << ", edges: " << edgeCount << "\n";
+    cout << fixed << setprecision(2);
+    cout << "CSV parse + freeze: " << textMs << " ms\n";
+    cout << "Binary .rnet load:  " << binaryMs << " ms\n";
+    remove(csvPath.c_str());
+    remove(binaryPath.c_str());
+}
+
+// Book and cancel from threadCount threads at once on a few trains with small coaches,
+// then recount every seat counter from the bookings that survived. Returns false if any
+// segment was oversold or a counter disagrees with the bookings holding it.
+bool stressSeatInventory(int threadCount) {
+    const int TRAINS = 4, ATTEMPTS_PER_THREAD = 50000, SEATS = 40;
+    generateSyntheticNetwork(2500, 42);
+    const StationGraph& graph = getStationGraph();
+    seatInventory.clear();
+    for (int c = GENERAL; c <= FIRST_CLASS; c++) seatInventory.capacity[c] = SEATS;
+
+    // Routes are searched up front so the threads only exercise the inventory; sources and
+    // destinations come from the middle of the grid so routes overlap heavily
+    mt19937 rng(3);
+    vector<vector<int> > routes;
+    while (routes.size() < 400) {
+        int source = 1000 + rng() % 500, destination = 1000 + rng() % 500;
+        if (source != destination) routes.push_back(dijkstra(source, destination, graph));
     }
-    
-    // Calculate shortest path using optimized Dijkstra
-    vector<int> path = dijkstra(fromStation, toStation, stations);
-    if (path.size() <= 1) {
-        cout << "No available path between selected stations.\n";
-        return;
+
+    struct Held {
+        int route, train;
+        TicketClass tClass;
+    };
+    vector<vector<Held> > held(threadCount);
+    atomic<long long> confirmed(0), soldOut(0), cancelled(0);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int t = 0; t < threadCount; t++) {
+        workers.push_back(thread([&, t]() {
+            mt19937 local(100 + t);
+            vector<Held>& mine = held[t];
+            for (int i = 0; i < ATTEMPTS_PER_THREAD; i++) {
+                if (!mine.empty() && local() % 3 == 0) {
+                    int pick = local() % mine.size();
+                    seatInventory.release(mine[pick].train, 0, mine[pick].tClass, routes[mine[pick].route]);
+                    mine[pick] = mine.back();
+                    mine.pop_back();
+                    cancelled++;
+                    continue;
+                }
+                Held booking = { (int)(local() % routes.size()), 1 + (int)(local() % TRAINS),
+                                 (TicketClass)(GENERAL + local() % 2) };
+                if (seatInventory.reserve(booking.train, 0, booking.tClass, routes[booking.route]) == -1) {
+                    mine.push_back(booking);
+                    confirmed++;
+                } else {
+                    soldOut++;
+                }
+            }
+        }));
     }
-    
-    // Calculate total distance from path
-    int totalDistance = 0;
-    for (int i = 0; i < path.size() - 1; i++) {
-        for (int j = 0; j < stations[path[i]].connections.size(); j++) {
-            pair<int, int> conn = stations[path[i]].connections[j];
-            if (conn.first == path[i + 1]) {
-                totalDistance += conn.second;
-                break;
+    for (int t = 0; t < threadCount; t++) workers[t].join();
+    double elapsed = elapsedMs(start);
+
+    unordered_map<uint64_t, int> expected;
+    for (int t = 0; t < threadCount; t++) {
+        for (int i = 0; i < held[t].size(); i++) {
+            const vector<int>& route = routes[held[t][i].route];
+            for (int j = 0; j + 1 < route.size(); j++) {
+                expected[SeatInventory::key(held[t][i].train, 0, held[t][i].tClass,
+                                            getSegmentId(route[j], route[j + 1]))]++;
             }
         }
     }
-    
-    TimeInfo timeInfo(totalDistance);
-    
-    cout << "\n=== Route Details ===\n";
-    cout << "From: " << stations[fromStation].name << "\n";
-    cout << "To: " << stations[toStation].name << "\n";
-    cout << "Distance: " << totalDistance << " km\n";
-    cout << "Route Path: " << getRoutePathString(path) << "\n";
-    cout << "Estimated Travel Time: " << (int)timeInfo.hours << " hours " 
-         << (int)timeInfo.minutes << " minutes\n";
-    
-    // Select ticket class
-    displayFareOptions();
-    cout << "Select ticket class (1-4): ";
-    int classChoice;
-    cin >> classChoice;
-    
-    if (classChoice < 1 || classChoice > 4) {
-        cout << "Invalid ticket class selection!\n";
-        return;
+    int oversold = 0, mismatched = 0, fullSegments = 0;
+    for (int s = 0; s < SeatInventory::SHARD_COUNT; s++) {
+        SeatInventoryShard& shard = seatInventory.shards[s];
+        for (unordered_map<uint64_t, atomic<int> >::iterator it = shard.sold.begin(); it != shard.sold.end(); it++) {
+            int sold = it->second.load();
+            unordered_map<uint64_t, int>::iterator want = expected.find(it->first);
+            if (sold > SEATS) oversold++;
+            if (sold == SEATS) fullSegments++;
+            if (sold != (want == expected.end() ? 0 : want->second)) mismatched++;
+        }
     }
-    
-    TicketClass selectedClass = static_cast<TicketClass>(classChoice);
-    int fare = getFareForClass(totalDistance, selectedClass);
-    
-    // Create booking
-    Booking newBooking(nextTicketNumber, passengerName, age, fromStation, toStation,
-                       selectedClass, totalDistance, fare, timeInfo.hours, currentUser);
-    bookings.push_back(newBooking);
-    
-    // Add booking ID to user's booking list
-    for (int i = 0; i < users.size(); i++) {
-        if (users[i].username == currentUser) {
-            users[i].bookingIds.push_back(nextTicketNumber);
-            break;
+
+    // With the threads gone, a request must be confirmed exactly when every leg has a seat
+    int wronglyRefused = 0, wronglyConfirmed = 0;
+    for (int r = 0; r < routes.size(); r++) {
+        for (int train = 1; train <= TRAINS; train++) {
+            for (int c = GENERAL; c <= SLEEPER; c++) {
+                const vector<int>& route = routes[r];
+                bool seatsLeft = true;
+                for (int j = 0; j + 1 < route.size(); j++) {
+                    if (seatInventory.available(train, 0, (TicketClass)c, route[j], route[j + 1]) <= 0) {
+                        seatsLeft = false;
+                    }
+                }
+                bool confirmedAlone = seatInventory.reserve(train, 0, (TicketClass)c, route) == -1;
+                if (confirmedAlone) seatInventory.release(train, 0, (TicketClass)c, route);
+                if (seatsLeft && !confirmedAlone) wronglyRefused++;
+                if (!seatsLeft && confirmedAlone) wronglyConfirmed++;
+            }
         }
     }
-    
-    // Display booking confirmation
-    cout << "\n=== Booking Confirmation ===\n";
-    cout << "Ticket Number: " << nextTicketNumber << "\n";
-    cout << "Passenger Name: " << passengerName << "\n";
-    cout << "Age: " << age << "\n";
-    cout << "From: " << stations[fromStation].name << "\n";
-    cout << "To: " << stations[toStation].name << "\n";
-    cout << "Class: " << getClassString(selectedClass) << "\n";
-    cout << "Distance: " << totalDistance << " km\n";
-    cout << "Travel Time: " << (int)timeInfo.hours << " hours " 
-         << (int)timeInfo.minutes << " minutes\n";
-    cout << "Fare: ₹" << fare << "\n";
-    cout << "Status: Confirmed\n";
-    cout << "\nBooking successful! Please save your ticket number.\n";
-    
-    nextTicketNumber++;
+
+    long long attempts = (long long)threadCount * ATTEMPTS_PER_THREAD;
+    cout << "\n=== Seat Inventory Stress Test ===\n";
+    cout << "Threads: " << threadCount << ", trains: " << TRAINS << ", seats per class: " << SEATS
+         << ", routes: " << routes.size() << "\n";
+    cout << "Attempts: " << attempts << " in " << fixed << setprecision(1) << elapsed << " ms ("
+         << setprecision(0) << attempts / elapsed * 1000 << " per second)\n";
+    cout << "Confirmed: " << confirmed << ", sold out: " << soldOut << ", cancelled: " << cancelled
+         << ", full segments at end: " << fullSegments << "\n";
+    cout << "Oversold segments: " << oversold << ", counters not matching bookings: " << mismatched << "\n";
+    cout << "Lone requests refused with seats left: " << wronglyRefused << ", confirmed without: "
+         << wronglyConfirmed << "\n";
+    bool ok = oversold == 0 && mismatched == 0 && wronglyRefused == 0 && wronglyConfirmed == 0;
+    cout << (ok ? "PASS" : "FAIL") << "\n";
+    return ok;
 }
 
-void viewMyBookings() {
-    if (currentUser == "") {
-        cout << "Please login first!\n";
-        return;
+// Client side of the request protocol for the load generator
+struct RequestClient {
+    int fd;
+    string input;
+
+    RequestClient() : fd(-1) {}
+
+    bool connectTo(int port) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        return fd != -1 && connect(fd, (sockaddr*)&address, sizeof(address)) == 0;
     }
-    
-    cout << "\n=== My Bookings ===\n";
-    bool hasBookings = false;
-    
-    for (int i = 0; i < bookings.size(); i++) {
-        if (bookings[i].username == currentUser) {
-            hasBookings = true;
-            cout << "\n--- Ticket #" << bookings[i].ticketNumber << " ---\n";
-            cout << "Passenger: " << bookings[i].passengerName << "\n";
-            cout << "Age: " << bookings[i].age << "\n";
-            cout << "From: " << stations[bookings[i].fromStation].name << "\n";
-            cout << "To: " << stations[bookings[i].toStation].name << "\n";
-            cout << "Class: " << getClassString(bookings[i].ticketClass) << "\n";
-            cout << "Distance: " << bookings[i].distance << " km\n";
-            cout << "Travel Time: " << (int)bookings[i].travelTime << " hours " 
-                 << (int)((bookings[i].travelTime - (int)bookings[i].travelTime) * 60) << " minutes\n";
-            cout << "Fare: ₹" << bookings[i].fare << "\n";
-            cout << "Status: " << (bookings[i].isActive ? "Active" : "Cancelled") << "\n";
+
+    // Send one request line and read its response line
+    bool call(const string& request, string& response) {
+        if (!writeFully(fd, request.data(), request.size())) return false;
+        size_t lineEnd;
+        char buffer[4096];
+        while ((lineEnd = input.find('\n')) == string::npos) {
+            ssize_t received = read(fd, buffer, sizeof(buffer));
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) return false;
+            input.append(buffer, received);
         }
+        response.assign(input, 0, lineEnd);
+        input.erase(0, lineEnd + 1);
+        return true;
     }
-    
-    if (!hasBookings) {
-        cout << "No bookings found.\n";
+
+    void close() {
+        if (fd != -1) ::close(fd);
+        fd = -1;
     }
-}
+};
 
-void cancelBooking() {
-    if (currentUser == "") {
-        cout << "Please login first!\n";
+// Start the request server on a synthetic network and drive it over loopback TCP from
+// connectionCount closed-loop clients for a few seconds: mostly fare and route quotes
+// with a skewed choice of stations, plus some bookings, cancellations and booking lists
+void benchmarkRequestServer(int connectionCount, int workerCount) {
+    const int STATION_COUNT = 5000;
+    const double SECONDS = 3.0;
+    generateSyntheticNetwork(STATION_COUNT, 42);
+    prepareRouteQueries();
+
+    // The writer is running before any worker can hand it a job
+    stateWriter.start();
+    RequestServer server;
+    if (!server.start(0, workerCount)) {
+        cout << "Could not start the request server\n";
+        stateWriter.stop();
         return;
     }
-    
-    cout << "\n=== Cancel Booking ===\n";
-    cout << "Enter ticket number to cancel: ";
-    int ticketNumber;
-    cin >> ticketNumber;
-    
-    for (int i = 0; i < bookings.size(); i++) {
-        if (bookings[i].ticketNumber == ticketNumber && 
-            bookings[i].username == currentUser && 
-            bookings[i].isActive) {
-            
-            bookings[i].isActive = false;
-            cout << "\nTicket #" << ticketNumber << " has been cancelled successfully.\n";
-            cout << "Passenger: " << bookings[i].passengerName << "\n";
-            cout << "Route: " << stations[bookings[i].fromStation].name 
-                 << " -> " << stations[bookings[i].toStation].name << "\n";
-            cout << "Refund Amount: ₹" << bookings[i].fare << "\n";
-            return;
-        }
+
+    atomic<long long> queries(0), mutations(0), errors(0);
+    vector<vector<double> > latencies(connectionCount);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<thread> clients;
+    for (int c = 0; c < connectionCount; c++) {
+        clients.push_back(thread([&, c]() {
+            RequestClient client;
+            string response;
+            if (!client.connectTo(server.port) ||
+                !client.call("REGISTER loaduser" + to_string(c) + " secret\n", response) ||
+                !client.call("LOGIN loaduser" + to_string(c) + " secret\n", response)) {
+                errors++;
+                client.close();
+                return;
+            }
+            mt19937 rng(1000 + c);
+            vector<int> tickets;
+            vector<double>& mine = latencies[c];
+            string request;
+            while (elapsedMs(start) < SECONDS * 1000) {
+                // Four in five trips start or end at one of the 64 busiest stations
+                int from = rng() % 5 ? (int)(rng() % 64) * (STATION_COUNT / 64) : (int)(rng() % STATION_COUNT);
+                int to = (int)(rng() % STATION_COUNT);
+                if (from == to) continue;
+                int kind = rng() % 100;
+                bool mutation = kind >= 95;
+                if (kind < 70) {
+                    request = "FARE " + to_string(from) + " " + to_string(to) + " " + to_string(1 + rng() % 4) + "\n";
+                } else if (kind < 95) {
+                    request = "ROUTE " + to_string(from) + " " + to_string(to) + "\n";
+                } else if (kind < 98 || tickets.empty()) {
+                    request = "BOOK " + to_string(from) + " " + to_string(to) + " " + to_string(1 + rng() % 4) + " " +
+                              to_string(12000 + rng() % 50) + " 2026-12-0" + to_string(1 + rng() % 9) +
+                              " 30 Load Test Passenger\n";
+                } else if (kind < 99) {
+                    request = "CANCEL " + to_string(tickets.back()) + "\n";
+                    tickets.pop_back();
+                } else {
+                    request = "BOOKINGS\n";
+                }
+                chrono::steady_clock::time_point sent = chrono::steady_clock::now();
+                if (!client.call(request, response)) {
+                    errors++;
+                    break;
+                }
+                mine.push_back(elapsedMs(sent));
+                if (mutation) mutations++;
+                else queries++;
+                if (request.compare(0, 5, "BOOK ") == 0 && response.compare(0, 3, "OK ") == 0) {
+                    tickets.push_back(atoi(response.c_str() + 3));
+                }
+            }
+            client.call("QUIT\n", response);
+            client.close();
+        }));
     }
-    
-    cout << "Ticket not found or already cancelled!\n";
+    for (int c = 0; c < connectionCount; c++) clients[c].join();
+    double elapsed = elapsedMs(start);
+    server.stop();
+    stateWriter.stop();
+
+    vector<double> all;
+    for (int c = 0; c < connectionCount; c++) all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+    sort(all.begin(), all.end());
+    cout << "\n=== Request Server Load Test ===\n";
+    cout << "Stations: " << STATION_COUNT << ", workers: " << workerCount << ", connections: " << connectionCount << "\n";
+    cout << fixed << setprecision(0);
+    cout << "Route/fare queries: " << queries << " (" << queries / elapsed * 1000 << " per second)\n";
+    cout << "Bookings, cancellations and lists: " << mutations << " (" << mutations / elapsed * 1000
+         << " per second)\n";
+    if (!all.empty()) {
+        cout << setprecision(3) << "Latency: p50 " << all[all.size() / 2] * 1000 << " us, p99 "
+             << all[all.size() * 99 / 100] * 1000 << " us\n";
+    }
+    cout << "Client errors: " << errors << ", bookings in ledger: " << bookingCount() << "\n";
 }
 
-void printPath(vector<int>& prev, int dest, int src) {
-    if (dest == src) {
-        cout << stations[src].name;
-        return;
+// Stations drawn with Zipf-distributed popularity: the k-th busiest station is picked
+// with weight 1/k^skew. Ranks are shuffled over the network so the hubs are spread out.
+struct ZipfSampler {
+    vector<double> cumulative;
+    vector<int> stationByRank;
+
+    ZipfSampler(int stationCount, double skew, mt19937& rng) {
+        stationByRank.resize(stationCount);
+        for (int i = 0; i < stationCount; i++) stationByRank[i] = i;
+        shuffle(stationByRank.begin(), stationByRank.end(), rng);
+        cumulative.resize(stationCount);
+        double total = 0.0;
+        for (int k = 0; k < stationCount; k++) {
+            total += 1.0 / pow(k + 1.0, skew);
+            cumulative[k] = total;
+        }
+        for (int k = 0; k < stationCount; k++) cumulative[k] /= total;
     }
-    if (prev[dest] == -1) {
-        cout << "No path exists";
-        return;
+
+    int sample(mt19937& rng) {
+        double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+        int rank = lower_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin();
+        return stationByRank[min(rank, (int)stationByRank.size() - 1)];
     }
-    
-    printPath(prev, prev[dest], src);
-    cout << " -> " << stations[dest].name;
+};
+
+// Resident set size of this process in MB
+double residentMegabytes() {
+    long pages = 0, resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        fclose(statm);
+    }
+    return resident * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
 }
 
-void dijkstraWithPath(int src, int dest = -1) {
-    if (dest != -1) {
-        // Use optimized Dijkstra for specific route
-        vector<int> path = dijkstra(src, dest, stations);
-        
-        cout << "\n=== Route Information ===\n";
-        cout << "From: " << stations[src].name << "\n";
-        cout << "To: " << stations[dest].name << "\n";
-        
-        if (path.size() <= 1) {
-            cout << "No route available!\n";
-            return;
-        }
-        
-    // Calculate total distance from path
-    int totalDistance = 0;
-    for (int i = 0; i < path.size() - 1; i++) {
-        for (int j = 0; j < stations[path[i]].connections.size(); j++) {
-            pair<int, int> conn = stations[path[i]].connections[j];
-            if (conn.first == path[i + 1]) {
-                totalDistance += conn.second;
-                break;
-            }
+// Drop every user, booking and sold seat, as after a fresh start without a data directory
+void resetBookingState() {
+    users.clear();
+    userIndex = UserIndex();
+    userNames = StringPool();
+    clearBookings();
+    seatInventory.clear();
+}
+
+// Throughput and latency of one workload of the suite; each sample is one operation
+// (or one group of operations, counted as groupSize)
+struct WorkloadResult {
+    vector<double> samplesUs;
+    int groupSize;
+    double elapsedMs;
+
+    WorkloadResult() : groupSize(1), elapsedMs(0.0) {}
+
+    void report(int stationCount, const char* workload, ostream* csv) {
+        sort(samplesUs.begin(), samplesUs.end());
+        long long operations = (long long)samplesUs.size() * groupSize;
+        double p50 = samplesUs.empty() ? 0.0 : samplesUs[samplesUs.size() / 2] / groupSize;
+        double p99 = samplesUs.empty() ? 0.0 : samplesUs[samplesUs.size() * 99 / 100] / groupSize;
+        double perSecond = elapsedMs > 0 ? operations / elapsedMs * 1000 : 0.0;
+        double rss = residentMegabytes();
+        cout << setw(9) << stationCount << "  " << left << setw(8) << workload << right << setw(10) << operations
+             << fixed << setprecision(0) << setw(14) << perSecond << setprecision(2) << setw(12) << p50
+             << setw(12) << p99 << setprecision(1) << setw(10) << rss << "\n";
+        if (csv != NULL) {
+            *csv << stationCount << "," << workload << "," << operations << "," << fixed << setprecision(0)
+                 << perSecond << "," << setprecision(3) << p50 << "," << p99 << "," << setprecision(1) << rss << "\n";
         }
     }
-        
-        cout << "Distance: " << totalDistance << " km\n";
-        cout << "Route: ";
-        for (int i = 0; i < path.size(); i++) {
-            cout << stations[path[i]].name;
-            if (i < path.size() - 1) cout << " -> ";
-        }
-        cout << "\n";
-        
-        // Get fare class choice
-        displayFareOptions();
-        cout << "Select ticket class (1-4): ";
-        int classChoice;
-        cin >> classChoice;
-        
-        if (classChoice >= 1 && classChoice <= 4) {
-            calculateFare(totalDistance, static_cast<TicketClass>(classChoice));
-        } else {
-            cout << "Invalid choice! Showing all fares:\n";
-            calculateFare(totalDistance, GENERAL);
+};
+
+// Reproducible benchmark suite over synthetic networks from 4 stations up to maxStations:
+// point-to-point dijkstra(), the single-source listing of dijkstraWithPath(src), fares,
+// and booking, cancelling and listing bookings, with Zipf-skewed origins and destinations.
+// Routing follows the --engine, --route-cache and --precompute-matrix options. Listings
+// are rendered in full but written to /dev/null. Seeds are fixed, so runs on the same
+// machine and options can be compared directly; reportPath also gets the rows as CSV.
+bool benchmarkSuite(int maxStations, const string& reportPath) {
+    const double ZIPF_SKEW = 1.0;
+    const int USERS = 1000, TRAINS = 50, DAYS = 30;
+    vector<int> sizes;
+    const int standardSizes[] = { 4, 100, 1000, 10000, 100000 };
+    for (int s = 0; s < 5 && standardSizes[s] < maxStations; s++) sizes.push_back(standardSizes[s]);
+    sizes.push_back(maxStations);
+
+    ofstream csvFile;
+    ostream* csv = NULL;
+    if (!reportPath.empty()) {
+        csvFile.open(reportPath.c_str());
+        if (!csvFile) {
+            cerr << "Could not write " << reportPath << "\n";
+            return false;
         }
-    } else {
-        // Show all shortest paths using traditional Dijkstra
-        int n = stations.size();
-        vector<int> dist(n, INT_MAX);
-        vector<int> prev(n, -1);
-        vector<bool> visited(n, false);
+        csvFile << "stations,workload,operations,per_second,p50_us,p99_us,rss_mb\n";
+        csv = &csvFile;
+    }
 
-        dist[src] = 0;
+    // Listings are built as usual but thrown away
+    int discard = open("/dev/null", O_WRONLY);
+    int screenFd = screen.fd;
+    screen.fd = discard;
 
-        for (int count = 0; count < n - 1; count++) {
-            int minDist = INT_MAX, u = -1;
-            for (int i = 0; i < n; i++) {
-                if (!visited[i] && dist[i] <= minDist) {
-                    minDist = dist[i];
-                    u = i;
-                }
-            }
+    const char* engineNames[] = { "", "dijkstra", "astar", "ch" };
+    cout << "\n=== Benchmark Suite ===\n";
+    cout << "Engine: " << engineNames[routeEngine] << ", route cache: "
+         << routeCache.capacityPerShard * RouteCache::SHARD_COUNT << " entries, distance matrix: "
+         << (useDistanceMatrix ? "on" : "off") << ", Zipf skew: " << ZIPF_SKEW << "\n";
+    cout << setw(9) << "Stations" << "  " << left << setw(8) << "Workload" << right << setw(10) << "Ops"
+         << setw(14) << "Ops/s" << setw(12) << "p50 us" << setw(12) << "p99 us" << setw(10) << "RSS MB" << "\n";
 
-            if (u == -1) break;
-            visited[u] = true;
+    for (int s = 0; s < sizes.size(); s++) {
+        int n = sizes[s];
+        generateSyntheticNetwork(n, 42);
+        prepareRouteQueries();
+        resetBookingState();
+        const StationGraph& graph = getStationGraph();
+        mt19937 rng(11);
+        ZipfSampler popularity(n, ZIPF_SKEW, rng);
+        chrono::steady_clock::time_point start, began;
 
-            for (int i = 0; i < stations[u].connections.size(); i++) {
-                int v = stations[u].connections[i].first;
-                int weight = stations[u].connections[i].second;
-                if (!visited[v] && dist[u] != INT_MAX && dist[u] + weight < dist[v]) {
-                    dist[v] = dist[u] + weight;
-                    prev[v] = u;
-                }
+        // Point-to-point routes
+        WorkloadResult routes;
+        int routeCount = max(200, min(20000, 20000000 / n));
+        vector<int> path, distances;
+        began = chrono::steady_clock::now();
+        for (int q = 0; q < routeCount; q++) {
+            int from = popularity.sample(rng), to = popularity.sample(rng);
+            start = chrono::steady_clock::now();
+            dijkstra(from, to, graph, path);
+            routes.samplesUs.push_back(elapsedMs(start) * 1000);
+            if (path.size() > 1) distances.push_back(searchWorkspace().route.totalDistance);
+        }
+        routes.elapsedMs = elapsedMs(began);
+        routes.report(n, "route", csv);
+
+        // Single-source listings
+        WorkloadResult listings;
+        int listingCount = max(3, min(1000, 300000 / n));
+        began = chrono::steady_clock::now();
+        for (int q = 0; q < listingCount; q++) {
+            int source = popularity.sample(rng);
+            start = chrono::steady_clock::now();
+            dijkstraWithPath(source);
+            listings.samplesUs.push_back(elapsedMs(start) * 1000);
+        }
+        listings.elapsedMs = elapsedMs(began);
+        listings.report(n, "paths", csv);
+
+        // Fares for the distances of the routes above, timed in groups since one quote takes nanoseconds
+        WorkloadResult fares;
+        fares.groupSize = 256;
+        if (distances.empty()) distances.push_back(0);
+        vector<int> quoted(fares.groupSize);
+        began = chrono::steady_clock::now();
+        for (int g = 0; g < 4000; g++) {
+            start = chrono::steady_clock::now();
+            for (int i = 0; i < fares.groupSize; i++) {
+                int distance = distances[(g * fares.groupSize + i) % distances.size()];
+                quoted[i] = getPassengerFare(distance, (TicketClass)(GENERAL + i % 4), 5 + i % 80);
             }
+            fares.samplesUs.push_back(elapsedMs(start) * 1000);
         }
+        fares.elapsedMs = elapsedMs(began);
+        fares.report(n, "fare", csv);
 
-        cout << "\nShortest distances and routes from " << stations[src].name << ":\n";
-        for (int i = 0; i < n; i++) {
-            if (i != src) {
-                cout << "\nTo " << stations[i].name << ": ";
-                if (dist[i] == INT_MAX) {
-                    cout << "Not Reachable\n";
-                } else {
-                    cout << dist[i] << " km\n";
-                    cout << "Route: ";
-                    printPath(prev, i, src);
-                    cout << "\n";
-                }
+        // Bookings: route, fare, seats on every segment and the ledger entry, as the server does.
+        // The ledger keeps 16-bit stations, so both ends and the route must stay below that.
+        for (int u = 0; u < USERS; u++) createUser("bench" + to_string(u), "secret");
+        WorkloadResult booked;
+        vector<pair<int, int> > tickets; // (user, ticket)
+        int bookingCount = max(200, min(20000, 20000000 / n));
+        RouteResult route;
+        began = chrono::steady_clock::now();
+        for (int q = 0; q < bookingCount; q++) {
+            int user = rng() % USERS, from = popularity.sample(rng), to = popularity.sample(rng);
+            TicketClass ticketClass = (TicketClass)(GENERAL + rng() % 4);
+            int train = 12000 + rng() % TRAINS, travelDay = 20000 + rng() % DAYS;
+            if (from == to || max(from, to) >= MAX_BOOKABLE_STATIONS) continue;
+            start = chrono::steady_clock::now();
+            findRoute(from, to, graph, route);
+            if (!route.found || *max_element(route.path.begin(), route.path.end()) >= MAX_BOOKABLE_STATIONS) continue;
+            int fare = getPassengerFare(route.totalDistance, ticketClass, 30);
+            if (seatInventory.reserve(train, travelDay, ticketClass, route.path) == -1) {
+                int ticket = recordBooking(user, "Suite Passenger", 30, from, to, ticketClass, route.totalDistance,
+                                           fare, train, travelDay, route.path);
+                tickets.push_back(make_pair(user, ticket));
             }
+            booked.samplesUs.push_back(elapsedMs(start) * 1000);
+        }
+        booked.elapsedMs = elapsedMs(began);
+        booked.report(n, "book", csv);
+
+        // Cancel every other ticket, in random order
+        WorkloadResult cancelled;
+        shuffle(tickets.begin(), tickets.end(), rng);
+        began = chrono::steady_clock::now();
+        for (int t = 0; t < tickets.size(); t += 2) {
+            start = chrono::steady_clock::now();
+            BookingRecord booking;
+            cancelTicket(tickets[t].first, tickets[t].second, booking);
+            cancelled.samplesUs.push_back(elapsedMs(start) * 1000);
         }
+        cancelled.elapsedMs = elapsedMs(began);
+        cancelled.report(n, "cancel", csv);
+
+        // List the bookings of random users
+        WorkloadResult viewed;
+        Session session;
+        began = chrono::steady_clock::now();
+        for (int q = 0; q < 2000; q++) {
+            session.userId = rng() % USERS;
+            start = chrono::steady_clock::now();
+            viewMyBookings(session);
+            viewed.samplesUs.push_back(elapsedMs(start) * 1000);
+        }
+        viewed.elapsedMs = elapsedMs(began);
+        viewed.report(n, "view", csv);
     }
+
+    screen.fd = screenFd;
+    close(discard);
+    resetBookingState();
+    return true;
 }
 
-void dijkstra(int src) {
-    int n = stations.size();
-    vector<int> dist(n, INT_MAX);
-    vector<bool> visited(n, false);
+// Book, cancel and list bookings from 1, 2, 4, ... threadCount threads at once, then check
+// every ticket: issued exactly once, numbered without gaps, listed once under its owner and
+// marked cancelled exactly when it was. Returns false on any lost or duplicate ticket.
+bool stressBookingEngine(int threadCount) {
+    const int USERS = 4096, OPERATIONS_PER_THREAD = 200000;
+    vector<int> route(1, 0);
+    route.push_back(1);
 
-    dist[src] = 0;
+    cout << "\n=== Booking Engine Stress Test ===\n";
+    cout << "Users: " << USERS << ", shards: " << BOOKING_SHARD_COUNT << ", operations per thread: "
+         << OPERATIONS_PER_THREAD << " (70% book, 20% cancel, 10% list)\n";
+    cout << left << setw(9) << "Threads" << right << setw(12) << "Bookings" << setw(12) << "Cancels"
+         << setw(12) << "Time ms" << setw(14) << "Ops/second" << setw(10) << "Speedup" << "  Check\n";
+    vector<int> rounds;
+    for (int threads = 1; threads < threadCount; threads *= 2) rounds.push_back(threads);
+    rounds.push_back(threadCount);
 
-    for (int count = 0; count < n - 1; count++) {
-        int minDist = INT_MAX, u;
-        for (int i = 0; i < n; i++) {
-            if (!visited[i] && dist[i] <= minDist) {
-                minDist = dist[i], u = i;
-            }
+    bool ok = true;
+    double singleThreadRate = 0;
+    for (int r = 0; r < rounds.size(); r++) {
+        int threads = rounds[r];
+        resetBookingState();
+        for (int u = 0; u < USERS; u++) createUser("stress" + to_string(u), "secret");
+
+        struct Issued {
+            int ticketNumber, userId;
+            bool cancelled;
+        };
+        vector<vector<Issued> > issued(threads);
+        atomic<int> failedCancels(0), doubleCancels(0);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        vector<thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(thread([&, t]() {
+                mt19937 local(200 + t);
+                vector<Issued>& mine = issued[t];
+                vector<int> active; // positions in mine that are not cancelled yet
+                vector<BookingRecord> listed;
+                BookingRecord cancelled;
+                for (int i = 0; i < OPERATIONS_PER_THREAD; i++) {
+                    int pick = local() % 10;
+                    if (pick < 2 && !active.empty()) {
+                        int at = local() % active.size();
+                        Issued& ticket = mine[active[at]];
+                        if (!cancelTicket(ticket.userId, ticket.ticketNumber, cancelled)) failedCancels++;
+                        if (cancelTicket(ticket.userId, ticket.ticketNumber, cancelled)) doubleCancels++;
+                        ticket.cancelled = true;
+                        active[at] = active.back();
+                        active.pop_back();
+                    } else if (pick < 3) {
+                        getUserBookings(local() % USERS, listed);
+                    } else {
+                        int userId = local() % USERS;
+                        Issued ticket = { recordBooking(userId, "Passenger", 30, 0, 1, SLEEPER, 100, 200, 1, 0, route),
+                                          userId, false };
+                        active.push_back(mine.size());
+                        mine.push_back(ticket);
+                    }
+                }
+            }));
         }
+        for (int t = 0; t < threads; t++) workers[t].join();
+        double elapsed = elapsedMs(start);
 
-        visited[u] = true;
+        // Every issued ticket, by number; the numbers must be exactly FIRST_TICKET_NUMBER..next-1
+        vector<Issued> all;
+        int cancelCount = 0;
+        for (int t = 0; t < threads; t++) {
+            all.insert(all.end(), issued[t].begin(), issued[t].end());
+        }
+        sort(all.begin(), all.end(), [](const Issued& a, const Issued& b) { return a.ticketNumber < b.ticketNumber; });
+        int misnumbered = 0, misfiled = 0;
+        for (int i = 0; i < all.size(); i++) {
+            if (all[i].ticketNumber != FIRST_TICKET_NUMBER + i) misnumbered++;
+            if (all[i].cancelled) cancelCount++;
+        }
+        if (nextTicketNumber != FIRST_TICKET_NUMBER + (int)all.size()) misnumbered++;
 
-        for (int i = 0; i < stations[u].connections.size(); i++) {
-            int v = stations[u].connections[i].first;
-            int weight = stations[u].connections[i].second;
-            if (!visited[v] && dist[u] + weight < dist[v]) {
-                dist[v] = dist[u] + weight;
+        // Each user's list must hold exactly that user's tickets, in order, with the right status
+        vector<vector<const Issued*> > byUser(USERS);
+        for (int i = 0; i < all.size(); i++) byUser[all[i].userId].push_back(&all[i]);
+        vector<BookingRecord> listed;
+        for (int u = 0; u < USERS; u++) {
+            getUserBookings(u, listed);
+            if (listed.size() != byUser[u].size()) {
+                misfiled++;
+                continue;
+            }
+            for (int i = 0; i < listed.size(); i++) {
+                if (listed[i].ticketNumber != byUser[u][i]->ticketNumber ||
+                    listed[i].active == byUser[u][i]->cancelled) misfiled++;
             }
         }
-    }
+        int lost = (int)all.size() - bookingCount();
+        bool passed = misnumbered == 0 && misfiled == 0 && lost == 0 && failedCancels == 0 && doubleCancels == 0;
 
-    cout << "\nShortest distances from " << stations[src].name << ":\n";
-    for (int i = 0; i < n; i++) {
-        cout << stations[i].name << ": ";
-        if (dist[i] == INT_MAX)
-            cout << "Not Reachable\n";
-        else
-            cout << dist[i] << " km\n";
+        double rate = (double)threads * OPERATIONS_PER_THREAD / elapsed * 1000;
+        if (r == 0) singleThreadRate = rate;
+        cout << left << setw(9) << threads << right << setw(12) << all.size() << setw(12) << cancelCount
+             << setw(12) << fixed << setprecision(1) << elapsed << setw(14) << setprecision(0) << rate
+             << setw(9) << setprecision(2) << rate / singleThreadRate << "x  " << (passed ? "ok" : "FAILED") << "\n";
+        if (!passed) {
+            cout << "  Misnumbered tickets: " << misnumbered << ", misfiled bookings: " << misfiled
+                 << ", lost bookings: " << lost << ", failed cancels: " << failedCancels
+                 << ", repeated cancels accepted: " << doubleCancels << "\n";
+        }
+        ok = ok && passed;
     }
+    resetBookingState();
+    cout << (ok ? "PASS" : "FAIL") << "\n";
+    return ok;
 }
 
-int main() {
-    addStation("New Delhi");
-    addStation("Kolkata");
-    addStation("Mumbai");
-    addStation("Chennai");
+// Built-in demo network used when no network file is available
+void loadDemoNetwork() {
+    addStation("New Delhi", 28.6139, 77.2090);
+    addStation("Kolkata", 22.5726, 88.3639);
+    addStation("Mumbai", 19.0760, 72.8777);
+    addStation("Chennai", 13.0827, 80.2707);
 
     addConnection(0, 1, 1450);
     addConnection(0, 2, 1400);
     addConnection(1, 3, 1650);
     addConnection(2, 3, 1350);
+}
+
+int main(int argc, char* argv[]) {
+    string networkPath = "";
+    string compiledNetworkPath = "";
+    string timetablePath = "";
+    int servePort = -1;
+    int workerCount = max(1, (int)thread::hardware_concurrency());
+    int benchServerConnections = 0;
+    string batchInputPath = "";
+    string batchOutputPath = "-";
+    bool batchBinary = false;
+    string statsFilePath = "";
+    int suiteStations = 0;
+    string suiteReportPath = "";
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--engine=dijkstra") {
+            routeEngine = ENGINE_DIJKSTRA;
+        } else if (arg == "--engine=astar") {
+            routeEngine = ENGINE_BIDIRECTIONAL_ASTAR;
+        } else if (arg == "--engine=ch") {
+            routeEngine = ENGINE_CONTRACTION_HIERARCHY;
+        } else if (arg.compare(0, 10, "--ch-file=") == 0) {
+            contractionHierarchyFile = arg.substr(10);
+        } else if (arg == "--precompute-matrix") {
+            useDistanceMatrix = true;
+        } else if (arg.compare(0, 14, "--route-cache=") == 0) {
+            setRouteCacheCapacity(atoi(arg.c_str() + 14));
+        } else if (arg == "--cache-stats") {
+            printRouteCacheStats = true;
+        } else if (arg == "--verify-routes") {
+            verifyRouteEngine = true;
+        } else if (arg.compare(0, 10, "--network=") == 0) {
+            networkPath = arg.substr(10);
+        } else if (arg.compare(0, 18, "--compile-network=") == 0) {
+            compiledNetworkPath = arg.substr(18);
+        } else if (arg == "--bench-network" || arg.compare(0, 16, "--bench-network=") == 0) {
+            int stationCount = arg.size() > 16 ? atoi(arg.c_str() + 16) : 10000;
+            benchmarkNetworkLoading(max(2, stationCount));
+            return 0;
+        } else if (arg.compare(0, 11, "--data-dir=") == 0) {
+            dataDirectory = arg.substr(11);
+        } else if (arg.compare(0, 17, "--snapshot-every=") == 0) {
+            snapshotInterval = max(1LL, atoll(arg.c_str() + 17));
+        } else if (arg.compare(0, 18, "--seats-per-class=") == 0) {
+            int seats = max(1, atoi(arg.c_str() + 18));
+            for (int c = GENERAL; c <= FIRST_CLASS; c++) seatInventory.capacity[c] = seats;
+        } else if (arg == "--stress-inventory" || arg.compare(0, 19, "--stress-inventory=") == 0) {
+            int threadCount = arg.size() > 19 ? atoi(arg.c_str() + 19) : (int)thread::hardware_concurrency();
+            return stressSeatInventory(max(1, threadCount)) ? 0 : 1;
+        } else if (arg == "--stress-bookings" || arg.compare(0, 18, "--stress-bookings=") == 0) {
+            int threadCount = arg.size() > 18 ? atoi(arg.c_str() + 18) : (int)thread::hardware_concurrency();
+            return stressBookingEngine(max(1, threadCount)) ? 0 : 1;
+        } else if (arg.compare(0, 9, "--tariff=") == 0) {
+            if (!loadTariff(arg.substr(9))) return 1;
+        } else if (arg == "--bench-fares" || arg.compare(0, 14, "--bench-fares=") == 0) {
+            int distanceCount = arg.size() > 14 ? atoi(arg.c_str() + 14) : 10000000;
+            return benchmarkFares(max(1, distanceCount)) ? 0 : 1;
+        } else if (arg.compare(0, 8, "--serve=") == 0) {
+            servePort = atoi(arg.c_str() + 8);
+        } else if (arg.compare(0, 10, "--workers=") == 0) {
+            workerCount = max(1, atoi(arg.c_str() + 10));
+        } else if (arg == "--bench-server" || arg.compare(0, 15, "--bench-server=") == 0) {
+            benchServerConnections = arg.size() > 15 ? max(1, atoi(arg.c_str() + 15)) : -1;
+        } else if (arg.compare(0, 8, "--batch=") == 0) {
+            batchInputPath = arg.substr(8);
+        } else if (arg.compare(0, 15, "--batch-output=") == 0) {
+            batchOutputPath = arg.substr(15);
+        } else if (arg == "--batch-format=csv" || arg == "--batch-format=binary") {
+            batchBinary = arg == "--batch-format=binary";
+        } else if (arg.compare(0, 12, "--timetable=") == 0) {
+            timetablePath = arg.substr(12);
+        } else if (arg == "--bench-timetable" || arg.compare(0, 18, "--bench-timetable=") == 0) {
+            int connectionCount = arg.size() > 18 ? atoi(arg.c_str() + 18) : 1000000;
+            benchmarkTimetable(max(1, connectionCount), 1000);
+            return 0;
+        } else if (arg == "--bench-pareto" || arg.compare(0, 15, "--bench-pareto=") == 0) {
+            int stationCount = arg.size() > 15 ? atoi(arg.c_str() + 15) : 10000;
+            return benchmarkParetoRoutes(max(2, stationCount), 200) ? 0 : 1;
+        } else if (arg == "--bench-kpaths" || arg.compare(0, 15, "--bench-kpaths=") == 0) {
+            int stationCount = arg.size() > 15 ? atoi(arg.c_str() + 15) : 10000;
+            benchmarkKShortestRoutes(max(2, stationCount), 10, 200);
+            return 0;
+        } else if (arg == "--bench-closures" || arg.compare(0, 17, "--bench-closures=") == 0) {
+            int stationCount = arg.size() > 17 ? atoi(arg.c_str() + 17) : 2000;
+            return benchmarkTrackClosures(max(2, min(stationCount, MAX_MATRIX_STATIONS)), 200) ? 0 : 1;
+        } else if (arg == "--bench-alloc" || arg.compare(0, 14, "--bench-alloc=") == 0) {
+            int stationCount = arg.size() > 14 ? atoi(arg.c_str() + 14) : 8000;
+            benchmarkSearchAllocations(max(2, stationCount), 1000);
+            return 0;
+        } else if (arg == "--bench-sssp") {
+            benchmarkSingleSource();
+            return 0;
+        } else if (arg == "--bench-suite" || arg.compare(0, 14, "--bench-suite=") == 0) {
+            suiteStations = arg.size() > 14 ? max(4, atoi(arg.c_str() + 14)) : 100000;
+        } else if (arg.compare(0, 15, "--bench-report=") == 0) {
+            suiteReportPath = arg.substr(15);
+        } else if (arg == "--metrics") {
+            metricsEnabled = true;
+        } else if (arg.compare(0, 13, "--stats-file=") == 0) {
+            metricsEnabled = true;
+            statsFilePath = arg.substr(13);
+        } else if (arg == "--output=json" || arg == "--output=text") {
+            jsonOutput = arg == "--output=json";
+        } else if (arg == "--bench-ch" || arg.compare(0, 11, "--bench-ch=") == 0) {
+            int stationCount = arg.size() > 11 ? atoi(arg.c_str() + 11) : 10000;
+            benchmarkContractionHierarchy(max(2, stationCount), 1000);
+            return 0;
+        } else {
+            cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (suiteStations > 0) {
+        bool ok = benchmarkSuite(suiteStations, suiteReportPath);
+        if (metricsEnabled) writeMetricsReport(cerr);
+        return ok ? 0 : 1;
+    }
+
+    if (benchServerConnections != 0) {
+        benchmarkRequestServer(benchServerConnections > 0 ? benchServerConnections : workerCount, workerCount);
+        if (metricsEnabled) writeMetricsReport(cerr);
+        return 0;
+    }
+
+    // An explicit --network must load; otherwise use data/network.csv if present, else the demo network.
+    // The bundled timetable goes with the bundled network.
+    if (networkPath.empty() && ifstream("data/network.csv")) {
+        networkPath = "data/network.csv";
+        if (timetablePath.empty() && ifstream("data/timetable.csv")) timetablePath = "data/timetable.csv";
+    }
+    if (!networkPath.empty()) {
+        if (!loadNetwork(networkPath)) {
+            return 1;
+        }
+    } else {
+        loadDemoNetwork();
+    }
+    if (!compiledNetworkPath.empty()) {
+        if (!saveNetworkBinary(compiledNetworkPath)) {
+            cerr << "Could not write " << compiledNetworkPath << "\n";
+            return 1;
+        }
+        cout << "Compiled " << stations.size() << " stations to " << compiledNetworkPath << "\n";
+        return 0;
+    }
+    freezeStationGraph();
+    if (!timetablePath.empty() && !loadTimetable(timetablePath)) {
+        return 1;
+    }
+    prepareRouteQueries();
+    if (!batchInputPath.empty()) {
+        return runBatch(batchInputPath, batchOutputPath, batchBinary, workerCount) ? 0 : 1;
+    }
+    if (!dataDirectory.empty() && !openDataDirectory()) {
+        return 1;
+    }
+
+    // Server mode runs until the process is killed; every change is already journaled by then
+    if (servePort >= 0) {
+        stateWriter.start();
+        RequestServer server;
+        if (!server.start(servePort, workerCount)) {
+            cerr << "Could not listen on 127.0.0.1:" << servePort << ": " << strerror(errno) << "\n";
+            stateWriter.stop();
+            return 1;
+        }
+        cerr << "Serving " << stations.size() << " stations on 127.0.0.1:" << server.port << " with "
+             << workerCount << " workers\n";
+        server.acceptor.join();
+        return 0;
+    }
+
+    // With JSON output only the responses go to stdout; menus, prompts and messages move to stderr
+    if (jsonOutput) {
+        cout.rdbuf(cerr.rdbuf());
+    }
 
+    Session console;
     while (true) {
         cout << "\n=== Smart Railway Management System ===\n";
         
-        if (currentUser == "") {
+        if (!console.loggedIn()) {
             cout << "🔐 Authentication Required\n";
             cout << "1. Register New User\n";
             cout << "2. Login\n";
@@ -626,27 +7116,28 @@ int main() {
             cout << "4. Find Route & Fare (Guest)\n";
             cout << "5. Exit\n";
         } else {
-            cout << "👤 Welcome, " << currentUser << "!\n";
+            cout << "👤 Welcome, " << getUsername(console.userId) << "!\n";
             cout << "1. Show All Stations\n";
             cout << "2. Find Shortest Paths from a Station\n";
             cout << "3. Find Route & Fare Between Two Stations\n";
             cout << "4. Book Ticket\n";
             cout << "5. View My Bookings\n";
             cout << "6. Cancel Booking\n";
-            cout << "7. Logout\n";
-            cout << "8. Exit\n";
+            cout << "7. Track Works\n";
+            cout << "8. Logout\n";
+            cout << "9. Exit\n";
         }
         
         cout << "Enter your choice: ";
         int choice;
         cin >> choice;
 
-        if (currentUser == "") {
+        if (!console.loggedIn()) {
             // Guest/Authentication menu
             if (choice == 1) {
                 registerUser();
             } else if (choice == 2) {
-                loginUser();
+                loginUser(console);
             } else if (choice == 3) {
                 displayStations();
             } else if (choice == 4) {
@@ -697,24 +7188,43 @@ int main() {
                     cout << "Invalid station indices or same source and destination!\n";
                 }
             } else if (choice == 4) {
-                bookTicket();
+                bookTicket(console);
             } else if (choice == 5) {
-                viewMyBookings();
+                viewMyBookings(console);
             } else if (choice == 6) {
-                cancelBooking();
+                cancelBooking(console);
             } else if (choice == 7) {
-                logoutUser();
+                manageTrackWorks();
             } else if (choice == 8) {
+                logoutUser(console);
+            } else if (choice == 9) {
                 break;
             } else {
                 cout << "Invalid choice. Try again.\n";
             }
         }
 
+        maybeTakeSnapshot();
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
         cout << "\nPress Enter to continue...";
         cin.get();
     }
 
+    if (journal.isOpen()) {
+        takeSnapshot();
+        journal.close();
+    }
+    if (printRouteCacheStats) {
+        displayRouteCacheStats();
+    }
+    if (metricsEnabled) {
+        if (statsFilePath.empty()) {
+            writeMetricsReport(cerr);
+        } else {
+            ofstream statsFile(statsFilePath.c_str());
+            writeMetricsReport(statsFile);
+            if (!statsFile) cerr << "Could not write " << statsFilePath << "\n";
+        }
+    }
     return 0;
 }
\ No newline at end of file